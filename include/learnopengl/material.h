@@ -0,0 +1,172 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+
+#include <string>
+#include <vector>
+
+// how a material has to be composited, cheapest first
+enum BlendMode {
+    BLEND_OPAQUE,   // no alpha at all, position-only depth pre-pass
+    BLEND_CUTOUT,   // binary alpha, alpha tested in the depth pre-pass, drawn without blending
+    BLEND_BLENDED   // soft alpha, drawn after the opaque geometry with blending on and depth writes off
+};
+
+enum CullMode {
+    CULL_BACK,
+    CULL_FRONT,
+    CULL_NONE
+};
+
+// classification of a texture's alpha channel, filled in by TextureFromFile
+enum AlphaUsage {
+    ALPHA_NONE,     // no alpha channel, or every texel is (almost) fully opaque
+    ALPHA_BINARY,   // texels are either opaque or fully transparent, with a thin anti-aliased rim
+    ALPHA_SMOOTH    // a significant part of the texture is partially transparent
+};
+
+// alpha thresholds (0-255) used when analysing texture alpha
+const unsigned char ALPHA_TRANSPARENT_BELOW = 16;
+const unsigned char ALPHA_OPAQUE_ABOVE = 240;
+
+// every material texture has a fixed unit, so a sampler only has to be pointed at its unit once per program
+enum MaterialTextureUnit {
+    UNIT_DIFFUSE,
+    UNIT_SPECULAR,
+    UNIT_NORMAL,
+    UNIT_HEIGHT,
+    MATERIAL_TEXTURE_UNITS
+};
+
+// sampler name of each unit, after the uniform prefix ("material.")
+const char *const MATERIAL_SAMPLER_NAMES[MATERIAL_TEXTURE_UNITS] = {
+    "texture_diffuse1",
+    "texture_specular1",
+    "texture_normal1",
+    "texture_height1"
+};
+
+// unit of a texture type name ("texture_diffuse" ...), -1 if unknown
+int MaterialTextureUnitOf(const std::string &type)
+{
+    for (int unit = 0; unit < MATERIAL_TEXTURE_UNITS; unit++) {
+        std::string sampler = MATERIAL_SAMPLER_NAMES[unit];
+        if (sampler.compare(0, sampler.size() - 1, type) == 0)
+            return unit;
+    }
+    return -1;
+}
+
+// render state and parameters of a mesh, built once when the model is imported;
+// binding it in the draw loop is a few integer binds, no strings and no uniform lookups
+struct Material {
+    BlendMode blendMode = BLEND_OPAQUE;
+    CullMode cullMode = CULL_BACK;
+    bool alphaTest = false;
+    float opacity = 1.0f;   // MTL 'd'
+    float shininess = 32.0f;   // MTL 'Ns'
+
+    // texture bound to each MaterialTextureUnit, 0 if the material has none
+    unsigned int textures[MATERIAL_TEXTURE_UNITS] = {0, 0, 0, 0};
+    std::string uniformPrefix = "material.";
+
+    void setUniformPrefix(const std::string &prefix)
+    {
+        uniformPrefix = prefix;
+        programs.clear();
+    }
+
+    // binds textures and parameters for the currently used program
+    void bind(unsigned int program)
+    {
+        const ProgramLocations &locations = locationsFor(program);
+        for (int unit = 0; unit < MATERIAL_TEXTURE_UNITS; unit++) {
+            if (!(locations.usedUnits & (1u << unit)) || textures[unit] == 0)
+                continue;
+            rg::glState().bindTexture(unit, GL_TEXTURE_2D, textures[unit]);
+        }
+        if (locations.shininess >= 0)
+            glUniform1f(locations.shininess, shininess);
+    }
+
+    // picks the pipeline state from MTL values ('d', 'map_d', 'illum') and the diffuse texture's alpha
+    void classify(float mtlOpacity, bool hasOpacityMap, int illum, bool twoSided, AlphaUsage diffuseAlpha)
+    {
+        opacity = mtlOpacity;
+        // illum 4, 6, 7 and 9 are the MTL transparency (glass/refraction) models
+        bool transparentIllum = illum == 4 || illum == 6 || illum == 7 || illum == 9;
+
+        if (opacity < 1.0f || transparentIllum || diffuseAlpha == ALPHA_SMOOTH)
+            blendMode = BLEND_BLENDED;
+        else if (hasOpacityMap || diffuseAlpha == ALPHA_BINARY)
+            blendMode = BLEND_CUTOUT;
+        else
+            blendMode = BLEND_OPAQUE;
+
+        alphaTest = blendMode == BLEND_CUTOUT;
+        // cutout cards (leaves, fern fronds) are seen from both sides
+        cullMode = (twoSided || blendMode != BLEND_OPAQUE) ? CULL_NONE : CULL_BACK;
+    }
+
+    void applyCullState() const
+    {
+        rg::GLState &state = rg::glState();
+        state.setEnabled(GL_CULL_FACE, cullMode != CULL_NONE);
+        if (cullMode != CULL_NONE)
+            state.cullFace(cullMode == CULL_FRONT ? GL_FRONT : GL_BACK);
+    }
+
+private:
+    // what a program reads from this material, resolved the first time they meet
+    struct ProgramLocations {
+        unsigned int program;
+        unsigned int usedUnits;   // bit per MaterialTextureUnit the program samples
+        GLint shininess;
+    };
+    std::vector<ProgramLocations> programs;
+
+    const ProgramLocations &locationsFor(unsigned int program)
+    {
+        for (const ProgramLocations &locations : programs)
+            if (locations.program == program)
+                return locations;
+
+        // the program is in use, so its samplers can be pointed at the fixed units right here
+        ProgramLocations locations{program, 0, -1};
+        for (int unit = 0; unit < MATERIAL_TEXTURE_UNITS; unit++) {
+            GLint sampler = glGetUniformLocation(program, (uniformPrefix + MATERIAL_SAMPLER_NAMES[unit]).c_str());
+            if (sampler < 0)
+                continue;
+            glUniform1i(sampler, unit);
+            locations.usedUnits |= 1u << unit;
+        }
+        locations.shininess = glGetUniformLocation(program, (uniformPrefix + "shininess").c_str());
+        programs.push_back(locations);
+        return programs.back();
+    }
+};
+
+// scans the alpha channel of an 8-bit RGBA image
+AlphaUsage AnalyzeAlpha(const unsigned char *data, int width, int height, int nrComponents)
+{
+    if (nrComponents != 4 && nrComponents != 2)
+        return ALPHA_NONE;
+
+    unsigned long transparent = 0;
+    unsigned long partial = 0;
+    unsigned long count = (unsigned long)width * (unsigned long)height;
+    for (unsigned long i = 0; i < count; i++) {
+        unsigned char a = data[i * nrComponents + nrComponents - 1];
+        if (a < ALPHA_TRANSPARENT_BELOW)
+            transparent++;
+        else if (a <= ALPHA_OPAQUE_ABOVE)
+            partial++;
+    }
+    if (transparent == 0 && partial == 0)
+        return ALPHA_NONE;
+    // anti-aliased cutout edges leave some partial texels, but far fewer than the holes themselves
+    return partial > transparent ? ALPHA_SMOOTH : ALPHA_BINARY;
+}
+#endif
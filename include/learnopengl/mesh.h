@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/material.h>
 
 #include <string>
 #include <vector>
@@ -31,6 +32,7 @@ struct Texture {
     unsigned int id;
     string type;
     string path;
+    AlphaUsage alpha = ALPHA_NONE;
 };
 
 class Mesh {
@@ -39,15 +41,23 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    Material             material;
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, Material material = Material())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->material = material;
+        // the first texture of each type gets the material's unit for that type
+        for(const Texture &texture : textures)
+        {
+            int unit = MaterialTextureUnitOf(texture.type);
+            if(unit >= 0 && this->material.textures[unit] == 0)
+                this->material.textures[unit] = texture.id;
+        }
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -56,41 +66,13 @@ public:
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
+        material.applyCullState();
+        // textures, sampler units and parameters were resolved at load time
+        material.bind(shader.ID);
 
-
-        // draw mesh
-        glBindVertexArray(VAO);
+        // draw mesh; the VAO stays bound, the next draw rebinds only if it uses another one
+        rg::glState().bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
 private:
@@ -21,7 +21,7 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, AlphaUsage *alpha = nullptr);
 
 
 
@@ -49,7 +49,7 @@ public:
 
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.material.setUniformPrefix(prefix);
         }
     }
 private:
@@ -176,10 +176,30 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-
-
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, classifyMaterial(material, diffuseMaps));
+    }
+
+    // decides opaque / cutout / blended from the MTL 'd', 'map_d' and 'illum' values and the diffuse alpha channel,
+    // and takes the scalar parameters ('Ns') over
+    Material classifyMaterial(aiMaterial *mat, const vector<Texture> &diffuseMaps)
+    {
+        float opacity = 1.0f;
+        mat->Get(AI_MATKEY_OPACITY, opacity);
+        int twoSided = 0;
+        mat->Get(AI_MATKEY_TWOSIDED, twoSided);
+        // newer assimp keeps the raw 'illum' value, older ones only map it to a shading model
+        int illum = 2;
+        mat->Get("$mat.illum", 0, 0, illum);
+        bool hasOpacityMap = mat->GetTextureCount(aiTextureType_OPACITY) > 0;
+        AlphaUsage diffuseAlpha = diffuseMaps.empty() ? ALPHA_NONE : diffuseMaps[0].alpha;
+
+        Material result;
+        result.classify(opacity, hasOpacityMap, illum, twoSided != 0, diffuseAlpha);
+        float shininess = 0.0f;
+        if(mat->Get(AI_MATKEY_SHININESS, shininess) == aiReturn_SUCCESS && shininess > 0.0f)
+            result.shininess = shininess;
+        return result;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +225,7 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = TextureFromFile(str.C_Str(), this->directory, false, &texture.alpha);
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -217,7 +237,7 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, AlphaUsage *alpha)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
@@ -239,6 +259,9 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
         else if (nrComponents == 4)
             format = GL_RGBA;
 
+        if (alpha)
+            *alpha = AnalyzeAlpha(data, width, height, nrComponents);
+
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
@@ -8,12 +8,17 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <map>
+#include <vector>
 #include <common.h>
+#include <rg/GLState.h>
+#include <rg/ProgramBinaryCache.h>
 class Shader
 {
 public:
-    unsigned int ID;
-    // constructor generates the shader on the fly
+    // program of the currently selected variant, valid after use()
+    unsigned int ID = 0;
+    // constructor only loads the sources, variants are compiled on demand
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
@@ -23,9 +28,6 @@ public:
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -64,50 +66,78 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        // 2. collect the feature keywords declared with '#pragma features A B ...'
+        collectFeatures(vertexCode);
+        collectFeatures(fragmentCode);
+        collectFeatures(geometryCode);
+    }
+    // variants
+    // ------------------------------------------------------------------------
+    // bitmask of a feature keyword, 0 if none of the sources declare it
+    unsigned int feature(const std::string &keyword) const
+    {
+        for(unsigned int i = 0; i < features.size(); i++)
+            if(features[i] == keyword)
+                return 1u << i;
+        return 0;
+    }
+    // compile-time constant injected into every variant ('#define name value'), e.g. loop bounds
+    void define(const std::string &name, int value)
+    {
+        constants += "#define " + name + " " + std::to_string(value) + "\n";
+        // variants submitted so far were built without it
+        for(auto &variant : variants)
+            release(variant.second);
+        variants.clear();
+        ID = 0;
+    }
+    // binding point of a uniform block, applied to every variant when it is linked
+    void blockBinding(const std::string &block, unsigned int binding)
+    {
+        blockBindings.emplace_back(block, binding);
+        for(auto &variant : variants)
+            if(variant.second.resolved)
+                applyBlockBindings(variant.second.program);
+    }
+    // selects the variant with the given feature bitmask; it is compiled the first time it is used
+    void select(unsigned int key)
+    {
+        if(key != selectedKey)
+            ID = 0;
+        selectedKey = key;
+    }
+    // hands the variant to the driver compiler without waiting for it; its status is only
+    // queried when the variant is first used, so submitting everything up front lets the
+    // driver compile in parallel (GL_KHR_parallel_shader_compile) or at least in the background
+    void submit(unsigned int key = 0)
+    {
+        if(variants.find(key) == variants.end())
+            variants[key] = submitVariant(key);
+    }
+    // true once using the variant will not block on the compiler
+    bool ready(unsigned int key = 0)
+    {
+        auto it = variants.find(key);
+        if(it == variants.end())
+            return false;
+        if(it->second.resolved || !rg::glExtensions().parallelShaderCompile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(it->second.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        rg::glState().useProgram(program()); 
+    }
+    // program of the selected variant, resolving it if needed
+    unsigned int program()
+    {
+        if(ID == 0)
+            ID = variant(selectedKey);
+        return ID;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -169,9 +199,162 @@ public:
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+    std::vector<std::string> features;   // bit i of a variant key enables features[i]
+    std::string constants;
+    std::vector<std::pair<std::string, unsigned int>> blockBindings;
+    struct Variant
+    {
+        unsigned int program = 0;
+        // stages stay alive between submit and resolve
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+        unsigned int geometry = 0;
+        uint64_t binaryKey = 0;
+        bool resolved = false;
+    };
+    std::map<unsigned int, Variant> variants;   // feature bitmask -> program
+    unsigned int selectedKey = 0;
+
+    void collectFeatures(const std::string &code)
+    {
+        std::istringstream lines(code);
+        std::string line;
+        while(std::getline(lines, line))
+        {
+            std::istringstream words(line);
+            std::string word;
+            if(!(words >> word) || word != "#pragma" || !(words >> word) || word != "features")
+                continue;
+            while(words >> word)
+                if(feature(word) == 0)
+                    features.push_back(word);
+        }
+    }
+    // '#define's for a variant key, placed right after the '#version' line
+    std::string injectDefines(const std::string &code, unsigned int key) const
+    {
+        if(code.empty())
+            return code;
+        std::string defines = constants;
+        for(unsigned int i = 0; i < features.size(); i++)
+            if(key & (1u << i))
+                defines += "#define " + features[i] + "\n";
+        size_t version = code.find("#version");
+        size_t insertAt = version == std::string::npos ? 0 : code.find('\n', version);
+        if(insertAt == std::string::npos)
+            return code + "\n" + defines;
+        if(version != std::string::npos)
+            insertAt++;
+        return code.substr(0, insertAt) + defines + code.substr(insertAt);
+    }
+    unsigned int variant(unsigned int key)
+    {
+        submit(key);
+        Variant &variant = variants[key];
+        if(!variant.resolved)
+            resolveVariant(key, variant);
+        return variant.program;
+    }
+    // submit phase: create, compile and link, no status queries
+    Variant submitVariant(unsigned int key)
+    {
+        std::string vertexVariant = injectDefines(vertexCode, key);
+        std::string fragmentVariant = injectDefines(fragmentCode, key);
+        std::string geometryVariant = injectDefines(geometryCode, key);
+        Variant variant;
+        variant.program = glCreateProgram();
+        // a warm binary cache skips compiling and linking altogether
+        variant.binaryKey = rg::ProgramBinaryCache::key({&vertexVariant, &fragmentVariant, &geometryVariant});
+        if(rg::ProgramBinaryCache::load(variant.binaryKey, variant.program))
+        {
+            applyBlockBindings(variant.program);
+            variant.resolved = true;
+            return variant;
+        }
+        const char* vShaderCode = vertexVariant.c_str();
+        const char * fShaderCode = fragmentVariant.c_str();
+        // vertex shader
+        variant.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(variant.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(variant.vertex);
+        // fragment Shader
+        variant.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(variant.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(variant.fragment);
+        // if geometry shader is given, compile geometry shader
+        if(!geometryCode.empty())
+        {
+            const char * gShaderCode = geometryVariant.c_str();
+            variant.geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(variant.geometry, 1, &gShaderCode, NULL);
+            glCompileShader(variant.geometry);
+        }
+        // shader Program
+        glAttachShader(variant.program, variant.vertex);
+        glAttachShader(variant.program, variant.fragment);
+        if(variant.geometry != 0)
+            glAttachShader(variant.program, variant.geometry);
+        rg::ProgramBinaryCache::prepareForLink(variant.program);
+        glLinkProgram(variant.program);
+        return variant;
+    }
+    // resolve phase: the first status query is where the driver compiler is waited on
+    void resolveVariant(unsigned int key, Variant &variant)
+    {
+        GLint linked = GL_FALSE;
+        glGetProgramiv(variant.program, GL_LINK_STATUS, &linked);
+        if(linked)
+        {
+            rg::ProgramBinaryCache::store(variant.binaryKey, variant.program);
+            applyBlockBindings(variant.program);
+        }
+        else
+        {
+            // only now is it worth asking which stage failed
+            checkCompileErrors(variant.vertex, "VERTEX");
+            checkCompileErrors(variant.fragment, "FRAGMENT");
+            if(variant.geometry != 0)
+                checkCompileErrors(variant.geometry, "GEOMETRY");
+            checkCompileErrors(variant.program, "PROGRAM");
+        }
+        // delete the shaders as they're linked into our program now and no longer necessery
+        deleteStages(variant);
+        variant.resolved = true;
+    }
+    void applyBlockBindings(unsigned int program)
+    {
+        for(const auto &binding : blockBindings)
+        {
+            GLuint index = glGetUniformBlockIndex(program, binding.first.c_str());
+            if(index != GL_INVALID_INDEX)
+                glUniformBlockBinding(program, index, binding.second);
+        }
+    }
+    void deleteStages(Variant &variant)
+    {
+        unsigned int stages[] = {variant.vertex, variant.fragment, variant.geometry};
+        for(unsigned int stage : stages)
+        {
+            if(stage == 0)
+                continue;
+            glDetachShader(variant.program, stage);
+            glDeleteShader(stage);
+        }
+        variant.vertex = variant.fragment = variant.geometry = 0;
+    }
+    void release(Variant &variant)
+    {
+        deleteStages(variant);
+        rg::glState().forgetProgram(variant.program);
+        glDeleteProgram(variant.program);
+        variant.program = 0;
+    }
+    // utility function for checking shader compilation/linking errors, returns true on success.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +376,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
@@ -0,0 +1,121 @@
+//
+// Bloom as a mip chain: the HDR scene is downsampled step by step starting at half resolution, the first
+// step also doing the bright pass, then walked back up with a tent filter, each level adding itself to the
+// next larger one. Every pass runs at half resolution or below and the wide blur comes from the small
+// mips, not from many taps.
+//
+
+#ifndef PROJECT_BASE_BLOOMCHAIN_H
+#define PROJECT_BASE_BLOOMCHAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Fullscreen.h>
+#include <rg/GLState.h>
+#include <rg/RenderTargetPool.h>
+
+#include <algorithm>
+
+namespace rg {
+
+class BloomChain {
+public:
+    static const int MAX_LEVELS = 8;
+
+    // levels used, the first is half the source size; levels below 2x2 are dropped
+    int levels = 6;
+    // tent radius of the upsample, in texels of the level being upsampled
+    float filterRadius = 1.0f;
+    // how much of the chain the composite adds to the scene; every level contributes, so well below 1
+    float strength = 0.2f;
+    // bright pass of the first downsample: luminance where bloom starts, and the soft ramp below it
+    float threshold = 1.0f;
+    float knee = 0.5f;
+
+    // levels the last render() ran
+    int levelCount() const {
+        return used;
+    }
+
+    // runs the chain on source (the HDR scene, width x height, of which the bottom left region is
+    // rendered) into target, a texture of half that size; the smaller levels are taken from pool in format
+    // and handed back before returning. brightPassVariant
+    // selects the BRIGHT_PASS variant of the downsample shader for the first step. Depth test and blending
+    // are back to the scene's defaults afterwards
+    void render(RenderTargetPool &pool, unsigned int source, int width, int height, const glm::vec2 &region,
+                unsigned int target, GLenum format, Shader &downsample, unsigned int brightPassVariant, Shader &upsample,
+                unsigned int unit) {
+        GLState &state = glState();
+        used = 0;
+        int w = width, h = height;
+        for (int level = 0; level < std::min(std::max(levels, 1), MAX_LEVELS); level++) {
+            w /= 2;
+            h /= 2;
+            if (w < 2 || h < 2)
+                break;
+            Level &mip = mips[level];
+            mip.width = w;
+            mip.height = h;
+            mip.texture = level == 0 ? target : pool.acquire({w, h, format, TARGET_FILTERED});
+            mip.fbo = pool.framebuffer(mip.texture);
+            used++;
+        }
+        state.setEnabled(GL_DEPTH_TEST, false);
+
+        unsigned int input = source;
+        glm::vec2 inputSize(width, height);
+        for (int level = 0; level < used; level++) {
+            const Level &mip = mips[level];
+            if (level < 2) {
+                downsample.select(level == 0 ? brightPassVariant : 0);
+                downsample.use();
+                downsample.setInt("source", unit);
+                downsample.setFloat("threshold", threshold);
+                downsample.setFloat("knee", knee);
+            }
+            state.bindFramebuffer(GL_FRAMEBUFFER, mip.fbo);
+            state.viewport(0, 0, mip.width, mip.height);
+            downsample.setVec2("texelSize", 1.0f / inputSize);
+            // the first step stretches the rendered region over the whole chain
+            downsample.setVec2("uvScale", level == 0 ? region : glm::vec2(1.0f));
+            downsample.setVec2("uvMax", level == 0 ? region - 0.5f / inputSize : glm::vec2(1.0f));
+            state.bindTexture(unit, GL_TEXTURE_2D, input);
+            DrawFullscreenTriangle();
+            input = mip.texture;
+            inputSize = glm::vec2(mip.width, mip.height);
+        }
+
+        upsample.use();
+        upsample.setInt("source", unit);
+        state.setEnabled(GL_BLEND, true);
+        glBlendFunc(GL_ONE, GL_ONE);
+        for (int level = used - 1; level > 0; level--) {
+            const Level &mip = mips[level];
+            const Level &larger = mips[level - 1];
+            state.bindFramebuffer(GL_FRAMEBUFFER, larger.fbo);
+            state.viewport(0, 0, larger.width, larger.height);
+            upsample.setVec2("filterRadius", filterRadius / glm::vec2(mip.width, mip.height));
+            state.bindTexture(unit, GL_TEXTURE_2D, mip.texture);
+            DrawFullscreenTriangle();
+            pool.release(mip.texture);
+        }
+        // the blended scene pass expects the usual alpha blending
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.setEnabled(GL_BLEND, false);
+        state.setEnabled(GL_DEPTH_TEST, true);
+    }
+
+private:
+    struct Level {
+        unsigned int texture = 0;
+        unsigned int fbo = 0;
+        int width = 0;
+        int height = 0;
+    };
+    Level mips[MAX_LEVELS];
+    int used = 0;
+};
+
+};
+#endif //PROJECT_BASE_BLOOMCHAIN_H
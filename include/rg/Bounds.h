@@ -0,0 +1,53 @@
+//
+// Bounding spheres of meshes and models, as vec4(center, radius) in local space.
+//
+
+#ifndef PROJECT_BASE_BOUNDS_H
+#define PROJECT_BASE_BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+
+#include <algorithm>
+
+namespace rg {
+
+// center (xyz) and radius (w) around the vertices' bounding box
+inline glm::vec4 BoundingSphere(const std::vector<Vertex> &vertices) {
+    if (vertices.empty())
+        return glm::vec4(0.0f);
+    glm::vec3 low = vertices[0].Position;
+    glm::vec3 high = low;
+    for (const Vertex &vertex : vertices) {
+        low = glm::min(low, vertex.Position);
+        high = glm::max(high, vertex.Position);
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float radius = 0.0f;
+    for (const Vertex &vertex : vertices)
+        radius = std::max(radius, glm::length(vertex.Position - center));
+    return glm::vec4(center, radius);
+}
+
+inline glm::vec4 BoundingSphere(const Mesh &mesh) {
+    return BoundingSphere(mesh.vertices);
+}
+
+inline glm::vec4 BoundingSphere(const Model &model) {
+    std::vector<Vertex> vertices;
+    for (const Mesh &mesh : model.meshes)
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    return BoundingSphere(vertices);
+}
+
+// the sphere in world space, the radius grows with the largest axis scale
+inline glm::vec4 TransformSphere(const glm::mat4 &model, const glm::vec4 &sphere) {
+    glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return glm::vec4(center, sphere.w * scale);
+}
+
+};
+#endif //PROJECT_BASE_BOUNDS_H
@@ -0,0 +1,63 @@
+//
+// Render scale that follows a GPU frame time budget. The scene renders into the bottom left part of the
+// full-size HDR target and the post pass stretches it back over the screen, so a change of scale costs
+// nothing but the next frame's viewport.
+//
+
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+class DynamicResolution {
+public:
+    bool enabled = true;
+    // GPU milliseconds a frame may take
+    float budget = 16.6f;
+    // per-axis scale limits
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // fraction of the way to the estimated scale taken per frame; the timings arrive a few frames late,
+    // a full step would overshoot
+    float response = 0.1f;
+
+    // feeds a new GPU frame time, 0 when no measurement arrived since the last call (feeding the same one
+    // twice would step the scale twice for it); returns the scale for this frame
+    float update(double gpuMilliseconds) {
+        if (!enabled) {
+            current = maxScale;
+            return current;
+        }
+        if (gpuMilliseconds <= 0.0)
+            return current;
+        float load = (float)gpuMilliseconds / budget;
+        // between 80 and 95% of the budget the scale holds still instead of hunting
+        if (load > 0.8f && load < 0.95f)
+            return current;
+        // the cost goes with the pixel count, the square of the scale; aim below the budget so the
+        // frame has room for a spike
+        float estimate = current * std::sqrt(0.875f / load);
+        current += (estimate - current) * response;
+        current = std::min(std::max(current, minScale), maxScale);
+        return current;
+    }
+
+    float scale() const {
+        return current;
+    }
+
+    // a full size scaled down, and by factor on top (the TAA upscale), even so the half-resolution passes
+    // line up
+    int scaled(int size, float factor = 1.0f) const {
+        return std::min(std::max(((int)(size * current * factor)) & ~1, 2), size);
+    }
+
+private:
+    float current = 1.0f;
+};
+
+};
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
@@ -0,0 +1,332 @@
+//
+// The frame as a graph of passes. A pass is registered once, with a setup callback that declares every
+// frame what the pass reads and writes under the current settings, and an execute callback that draws.
+// Each frame the graph drops the passes nothing visible depends on, orders the rest so that writers run
+// before readers, holds every transient target only from the first to the last pass using it and binds
+// the pass's framebuffer and viewport before calling it. A released target is only handed out again for
+// the same format and size, so transients are reused from frame to frame, not shared between targets
+// of different descriptors within one.
+//
+
+#ifndef PROJECT_BASE_FRAMEGRAPH_H
+#define PROJECT_BASE_FRAMEGRAPH_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+#include <rg/RenderTargetPool.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+typedef int FrameResource;
+
+class FrameGraph {
+public:
+    // handed to a pass's setup callback
+    class Builder {
+    public:
+        // the pass samples r as the passes registered before it left it: it runs after those writing r,
+        // and before the ones registered after it that write r
+        void read(FrameResource r) {
+            graph.passes[pass].reads.push_back(r);
+        }
+
+        // the pass renders into r, after the passes registered before it that write r too. Transient
+        // targets and the backbuffer are attached to the framebuffer the graph binds, cleared first if
+        // clear is set; the pass binds imported textures itself
+        void write(FrameResource r, bool clear = false) {
+            graph.passes[pass].writes.push_back({r, clear});
+        }
+
+        // keeps the pass even when nothing reads what it writes
+        void sideEffect() {
+            graph.passes[pass].sideEffect = true;
+        }
+
+        // renders into the bottom left width x height of its targets instead of all of them
+        void viewport(int width, int height) {
+            graph.passes[pass].viewportWidth = width;
+            graph.passes[pass].viewportHeight = height;
+        }
+
+    private:
+        friend class FrameGraph;
+        Builder(FrameGraph &graph, int pass) : graph(graph), pass(pass) {}
+        FrameGraph &graph;
+        int pass;
+    };
+
+    // a target of the pool's screen size divided by divisor, alive only while passes use it
+    FrameResource createTarget(const char *name, GLenum format, unsigned int usage = TARGET_FILTERED, int divisor = 1) {
+        Resource resource;
+        resource.name = name;
+        resource.kind = TRANSIENT;
+        resource.format = format;
+        resource.usage = usage;
+        resource.divisor = divisor;
+        resources.push_back(resource);
+        return (FrameResource)resources.size() - 1;
+    }
+
+    // a texture owned outside the graph (shadow maps); only tracked for ordering and culling
+    FrameResource importTexture(const char *name, unsigned int texture) {
+        Resource resource;
+        resource.name = name;
+        resource.kind = IMPORTED;
+        resource.texture = texture;
+        resources.push_back(resource);
+        return (FrameResource)resources.size() - 1;
+    }
+
+    // the default framebuffer; a pass writing it is always kept
+    FrameResource backbuffer() {
+        if (backbufferResource < 0) {
+            Resource resource;
+            resource.name = "backbuffer";
+            resource.kind = BACKBUFFER;
+            resources.push_back(resource);
+            backbufferResource = (FrameResource)resources.size() - 1;
+        }
+        return backbufferResource;
+    }
+
+    void addPass(const char *name, std::function<void(Builder &)> setup, std::function<void()> execute) {
+        Pass pass;
+        pass.name = name;
+        pass.setup = std::move(setup);
+        pass.execute = std::move(execute);
+        passes.push_back(pass);
+    }
+
+    // the texture behind r; a transient one only inside the execute of a pass that declared it
+    unsigned int texture(FrameResource r) const {
+        return resources[r].texture;
+    }
+
+    // runs setup, culling and ordering, then the live passes; transient targets come from pool, sized by
+    // the pool's current screen size
+    void execute(RenderTargetPool &pool) {
+        for (size_t i = 0; i < passes.size(); i++) {
+            Pass &pass = passes[i];
+            pass.reads.clear();
+            pass.writes.clear();
+            pass.sideEffect = false;
+            pass.viewportWidth = pass.viewportHeight = 0;
+            Builder builder(*this, (int)i);
+            pass.setup(builder);
+        }
+        cull();
+        schedule();
+        for (Resource &resource : resources)
+            resource.first = resource.last = -1;
+        for (int step = 0; step < (int)order.size(); step++) {
+            const Pass &pass = passes[order[step]];
+            auto touch = [&](FrameResource r) {
+                Resource &resource = resources[r];
+                if (resource.first < 0)
+                    resource.first = step;
+                resource.last = step;
+            };
+            for (FrameResource r : pass.reads)
+                touch(r);
+            for (const Write &write : pass.writes)
+                touch(write.resource);
+        }
+
+        GLState &state = glState();
+        executedNames.clear();
+        for (int step = 0; step < (int)order.size(); step++) {
+            const Pass &pass = passes[order[step]];
+            for (Resource &resource : resources) {
+                if (resource.kind == TRANSIENT && resource.first == step) {
+                    resource.desc = pool.screen(resource.format, resource.usage, resource.divisor);
+                    resource.texture = pool.acquire(resource.desc);
+                }
+            }
+            bind(pool, state, pass);
+            pass.execute();
+            executedNames.push_back(pass.name);
+            for (Resource &resource : resources) {
+                if (resource.kind == TRANSIENT && resource.last == step) {
+                    pool.release(resource.texture);
+                    resource.texture = 0;
+                }
+            }
+        }
+    }
+
+    // the passes of the last frame in the order they ran
+    const std::vector<std::string> &executed() const {
+        return executedNames;
+    }
+
+    size_t passCount() const {
+        return passes.size();
+    }
+
+private:
+    enum ResourceKind {
+        TRANSIENT,
+        IMPORTED,
+        BACKBUFFER
+    };
+    struct Resource {
+        std::string name;
+        ResourceKind kind = TRANSIENT;
+        GLenum format = GL_NONE;
+        unsigned int usage = TARGET_FILTERED;
+        int divisor = 1;
+        RenderTargetDesc desc = {0, 0, GL_NONE, 0};
+        unsigned int texture = 0;
+        // steps of the first and last pass using it this frame, -1 if none
+        int first = -1;
+        int last = -1;
+    };
+    struct Write {
+        FrameResource resource;
+        bool clear;
+    };
+    struct Pass {
+        std::string name;
+        std::function<void(Builder &)> setup;
+        std::function<void()> execute;
+        std::vector<FrameResource> reads;
+        std::vector<Write> writes;
+        bool sideEffect = false;
+        bool live = false;
+        // 0: the whole target
+        int viewportWidth = 0;
+        int viewportHeight = 0;
+    };
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    // indices into passes, in execution order
+    std::vector<int> order;
+    std::vector<std::string> executedNames;
+    FrameResource backbufferResource = -1;
+
+    bool writes(const Pass &pass, FrameResource r) const {
+        for (const Write &write : pass.writes)
+            if (write.resource == r)
+                return true;
+        return false;
+    }
+
+    // a pass is live if it writes the backbuffer, has a side effect, or writes something a live pass reads
+    void cull() {
+        std::vector<bool> needed(resources.size(), false);
+        for (Pass &pass : passes)
+            pass.live = pass.sideEffect || (backbufferResource >= 0 && writes(pass, backbufferResource));
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (Pass &pass : passes) {
+                if (pass.live) {
+                    for (FrameResource r : pass.reads)
+                        needed[r] = true;
+                    continue;
+                }
+                for (const Write &write : pass.writes) {
+                    if (needed[write.resource]) {
+                        pass.live = true;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // b has to run after a, registered before it: b reads what a writes, or writes what a reads or writes
+    bool dependsOn(int b, int a) const {
+        if (a > b)
+            return false;
+        const Pass &before = passes[a];
+        const Pass &after = passes[b];
+        for (FrameResource r : after.reads)
+            if (writes(before, r) && !writes(after, r))
+                return true;
+        for (const Write &write : after.writes) {
+            if (writes(before, write.resource))
+                return true;
+            for (FrameResource r : before.reads)
+                if (r == write.resource)
+                    return true;
+        }
+        return false;
+    }
+
+    // topological order of the live passes, ties in registration order
+    void schedule() {
+        order.clear();
+        std::vector<bool> done(passes.size(), false);
+        int live = 0;
+        for (const Pass &pass : passes)
+            live += pass.live ? 1 : 0;
+        while ((int)order.size() < live) {
+            int next = -1;
+            for (int i = 0; i < (int)passes.size() && next < 0; i++) {
+                if (!passes[i].live || done[i])
+                    continue;
+                bool ready = true;
+                for (int j = 0; j < (int)passes.size() && ready; j++)
+                    if (j != i && passes[j].live && !done[j] && dependsOn(i, j))
+                        ready = false;
+                if (ready)
+                    next = i;
+            }
+            // every dependency points back in registration order, so there is always a next pass; kept
+            // so a graph that breaks that degrades to registration order instead of looping
+            if (next < 0)
+                for (int i = 0; i < (int)passes.size() && next < 0; i++)
+                    if (passes[i].live && !done[i])
+                        next = i;
+            done[next] = true;
+            order.push_back(next);
+        }
+    }
+
+    // the framebuffer of the pass's transient attachments, or the backbuffer, with its viewport and clears
+    void bind(RenderTargetPool &pool, GLState &state, const Pass &pass) {
+        unsigned int color = 0, depth = 0;
+        GLbitfield clear = 0;
+        bool backbuffer = false;
+        RenderTargetDesc size = {0, 0, GL_NONE, 0};
+        for (const Write &write : pass.writes) {
+            const Resource &resource = resources[write.resource];
+            if (resource.kind == BACKBUFFER) {
+                backbuffer = true;
+                size = pool.screen(GL_NONE);
+                if (write.clear)
+                    clear |= GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+            } else if (resource.kind == TRANSIENT) {
+                bool isDepth = RenderTargetPool::IsDepthFormat(resource.format);
+                (isDepth ? depth : color) = resource.texture;
+                size = resource.desc;
+                if (write.clear)
+                    clear |= isDepth ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT;
+            }
+        }
+        if (color || depth)
+            state.bindFramebuffer(GL_FRAMEBUFFER, pool.framebuffer(color, depth));
+        else if (backbuffer)
+            state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        else
+            return;
+        if (pass.viewportWidth > 0)
+            state.viewport(0, 0, pass.viewportWidth, pass.viewportHeight);
+        else
+            state.viewport(0, 0, size.width, size.height);
+        if (clear) {
+            state.colorMask(true);
+            state.depthMask(true);
+            glClear(clear);
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_FRAMEGRAPH_H
@@ -0,0 +1,24 @@
+//
+// The fullscreen triangle the post passes draw with fullscreen.vs. It is one triangle rather than a quad,
+// so there is no diagonal seam where the two halves would each shade the same 2x2 quads.
+//
+
+#ifndef PROJECT_BASE_FULLSCREEN_H
+#define PROJECT_BASE_FULLSCREEN_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+
+namespace rg {
+
+// positions come from gl_VertexID, the core profile still wants some vertex array bound
+inline void DrawFullscreenTriangle() {
+    static unsigned int emptyVAO = 0;
+    if (emptyVAO == 0)
+        glGenVertexArrays(1, &emptyVAO);
+    glState().bindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+};
+#endif //PROJECT_BASE_FULLSCREEN_H
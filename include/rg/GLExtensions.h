@@ -0,0 +1,189 @@
+//
+// Entry points and tokens newer than the GL 3.3 core profile glad was generated for.
+// They are loaded at runtime and every feature using them has a 3.3 fallback.
+//
+
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+#include <cstring>
+#include <string>
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile (ARB_ has the same values)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// GL 4.0 / ARB_draw_indirect
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// GL 4.0 / ARB_texture_cube_map_array
+#ifndef GL_TEXTURE_CUBE_MAP_ARRAY
+#define GL_TEXTURE_CUBE_MAP_ARRAY 0x9009
+#endif
+
+// GL 4.3 / ARB_compute_shader, ARB_shader_storage_buffer_object
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace rg {
+
+typedef void (APIENTRYP PFNRGGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNRGPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNRGPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNRGMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+typedef void (APIENTRYP PFNRGDISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFNRGMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNRGBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFNRGCOPYIMAGESUBDATAPROC)(GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY, GLint srcZ,
+                                                   GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ,
+                                                   GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth);
+typedef void (APIENTRYP PFNRGMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+struct GLExtensions {
+    bool loaded = false;
+    int major = 3;
+    int minor = 3;
+    std::string vendor;
+    std::string renderer;
+    std::string version;
+
+    // program binaries
+    bool programBinary = false;
+    PFNRGGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+    PFNRGPROGRAMBINARYPROC ProgramBinary = nullptr;
+    PFNRGPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+    // compiles run on driver threads and can be polled with GL_COMPLETION_STATUS_KHR
+    bool parallelShaderCompile = false;
+    PFNRGMAXSHADERCOMPILERTHREADSPROC MaxShaderCompilerThreads = nullptr;
+
+    // indirect draws whose commands honour baseInstance
+    bool multiDrawIndirect = false;
+    PFNRGMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+
+    // immutable buffers that can stay mapped while the GPU reads them
+    bool bufferStorage = false;
+    PFNRGBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+    // texture to texture copies without a framebuffer round trip (all six cube faces in one call)
+    bool copyImage = false;
+    PFNRGCOPYIMAGESUBDATAPROC CopyImageSubData = nullptr;
+
+    // samplerCubeArray in #version 330 sources through '#extension GL_ARB_texture_cube_map_array'
+    bool cubeMapArray = false;
+
+    // gl_Layer written by the vertex shader (ARB_shader_viewport_layer_array or AMD_vertex_shader_layer)
+    bool vertexShaderLayer = false;
+
+    // compute shaders writing shader storage buffers (#version 430 sources)
+    bool computeShader = false;
+    PFNRGDISPATCHCOMPUTEPROC DispatchCompute = nullptr;
+    PFNRGMEMORYBARRIERPROC MemoryBarrier = nullptr;
+
+    bool atLeast(int wantMajor, int wantMinor) const {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+
+    bool has(const char *extension) const {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name && std::strcmp(name, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+inline GLExtensions &glExtensions() {
+    static GLExtensions extensions;
+    return extensions;
+}
+
+// call once after gladLoadGLLoader, with the same loader
+void loadGLExtensions(GLADloadproc load) {
+    GLExtensions &ext = glExtensions();
+    glGetIntegerv(GL_MAJOR_VERSION, &ext.major);
+    glGetIntegerv(GL_MINOR_VERSION, &ext.minor);
+    ext.vendor = (const char *)glGetString(GL_VENDOR);
+    ext.renderer = (const char *)glGetString(GL_RENDERER);
+    ext.version = (const char *)glGetString(GL_VERSION);
+
+    if (ext.atLeast(4, 1) || ext.has("GL_ARB_get_program_binary")) {
+        ext.GetProgramBinary = (PFNRGGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        ext.ProgramBinary = (PFNRGPROGRAMBINARYPROC)load("glProgramBinary");
+        ext.ProgramParameteri = (PFNRGPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        ext.programBinary = ext.GetProgramBinary && ext.ProgramBinary && ext.ProgramParameteri && formats > 0;
+    }
+    if (ext.has("GL_KHR_parallel_shader_compile"))
+        ext.MaxShaderCompilerThreads = (PFNRGMAXSHADERCOMPILERTHREADSPROC)load("glMaxShaderCompilerThreadsKHR");
+    else if (ext.has("GL_ARB_parallel_shader_compile"))
+        ext.MaxShaderCompilerThreads = (PFNRGMAXSHADERCOMPILERTHREADSPROC)load("glMaxShaderCompilerThreadsARB");
+    if (ext.MaxShaderCompilerThreads) {
+        // let the driver pick as many threads as it wants
+        ext.MaxShaderCompilerThreads(0xFFFFFFFF);
+        ext.parallelShaderCompile = true;
+    }
+    if (ext.atLeast(4, 3) || (ext.has("GL_ARB_multi_draw_indirect") && ext.has("GL_ARB_base_instance"))) {
+        ext.MultiDrawElementsIndirect = (PFNRGMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+        ext.multiDrawIndirect = ext.MultiDrawElementsIndirect != nullptr;
+    }
+    if (ext.atLeast(4, 4) || ext.has("GL_ARB_buffer_storage")) {
+        ext.BufferStorage = (PFNRGBUFFERSTORAGEPROC)load("glBufferStorage");
+        ext.bufferStorage = ext.BufferStorage != nullptr;
+    }
+    if (ext.atLeast(4, 3) || ext.has("GL_ARB_copy_image")) {
+        ext.CopyImageSubData = (PFNRGCOPYIMAGESUBDATAPROC)load("glCopyImageSubData");
+        ext.copyImage = ext.CopyImageSubData != nullptr;
+    }
+    ext.cubeMapArray = ext.has("GL_ARB_texture_cube_map_array");
+    ext.vertexShaderLayer = ext.has("GL_ARB_shader_viewport_layer_array") || ext.has("GL_AMD_vertex_shader_layer");
+    if (ext.atLeast(4, 3)) {
+        ext.DispatchCompute = (PFNRGDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+        ext.MemoryBarrier = (PFNRGMEMORYBARRIERPROC)load("glMemoryBarrier");
+        ext.computeShader = ext.DispatchCompute && ext.MemoryBarrier;
+    }
+    ext.loaded = true;
+}
+
+};
+#endif //PROJECT_BASE_GLEXTENSIONS_H
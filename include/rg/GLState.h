@@ -0,0 +1,219 @@
+//
+// Shadow copy of the GL state the renderer touches. Calls that would not change anything are
+// dropped before they reach the driver; everything else goes through unchanged.
+//
+
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+class GLState {
+public:
+    static const int MAX_TEXTURE_UNITS = 16;
+
+    // calls that reached the driver vs. calls the cache answered, reset with resetCounters()
+    unsigned long issued = 0;
+    unsigned long elided = 0;
+
+    GLState() {
+        invalidate();
+    }
+
+    // forget everything, the next call of each kind is issued; use after code that changes state behind
+    // the cache's back
+    void invalidate() {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (int target = 0; target < TEXTURE_TARGETS; target++)
+                textures[unit][target] = UNKNOWN;
+        readFramebuffer = UNKNOWN;
+        drawFramebuffer = UNKNOWN;
+        for (int cap = 0; cap < CAPABILITIES; cap++)
+            capabilities[cap] = UNKNOWN;
+        cullFaceMode = UNKNOWN;
+        depthFunction = UNKNOWN;
+        depthWrite = UNKNOWN;
+        colorWrite = UNKNOWN;
+        viewportRect[0] = viewportRect[1] = viewportRect[2] = viewportRect[3] = UNKNOWN;
+    }
+
+    void resetCounters() {
+        issued = 0;
+        elided = 0;
+    }
+
+    void useProgram(unsigned int id) {
+        if (changed(program, id))
+            glUseProgram(id);
+    }
+
+    void bindVertexArray(unsigned int id) {
+        if (changed(vertexArray, id))
+            glBindVertexArray(id);
+    }
+
+    void activeTexture(unsigned int unit) {
+        if (changed(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // only GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP are tracked, other targets always go through
+    void bindTexture(unsigned int unit, GLenum target, unsigned int id) {
+        int slot = targetSlot(target);
+        if (slot < 0 || unit >= (unsigned int)MAX_TEXTURE_UNITS) {
+            activeTexture(unit);
+            glBindTexture(target, id);
+            issued++;
+            return;
+        }
+        if (textures[unit][slot] == id) {
+            elided++;
+            return;
+        }
+        activeTexture(unit);
+        textures[unit][slot] = id;
+        glBindTexture(target, id);
+        issued++;
+    }
+
+    // a deleted name may come back from glGen*, so the cache must not keep believing it is bound
+    void forgetTexture(unsigned int id) {
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (int target = 0; target < TEXTURE_TARGETS; target++)
+                if (textures[unit][target] == id)
+                    textures[unit][target] = UNKNOWN;
+    }
+
+    void forgetFramebuffer(unsigned int id) {
+        if (readFramebuffer == id)
+            readFramebuffer = UNKNOWN;
+        if (drawFramebuffer == id)
+            drawFramebuffer = UNKNOWN;
+    }
+
+    void forgetProgram(unsigned int id) {
+        if (program == id)
+            program = UNKNOWN;
+    }
+
+    void bindFramebuffer(GLenum target, unsigned int id) {
+        if (target == GL_FRAMEBUFFER) {
+            if (readFramebuffer == id && drawFramebuffer == id) {
+                elided++;
+                return;
+            }
+            readFramebuffer = drawFramebuffer = id;
+        } else if (!changed(target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer, id)) {
+            return;
+        }
+        glBindFramebuffer(target, id);
+        issued++;
+    }
+
+    void setEnabled(GLenum cap, bool enabled) {
+        int slot = capabilitySlot(cap);
+        if (slot >= 0 && !changed(capabilities[slot], enabled ? 1u : 0u))
+            return;
+        if (slot < 0)
+            issued++;
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+
+    void cullFace(GLenum mode) {
+        if (changed(cullFaceMode, mode))
+            glCullFace(mode);
+    }
+
+    void depthFunc(GLenum func) {
+        if (changed(depthFunction, func))
+            glDepthFunc(func);
+    }
+
+    void depthMask(bool write) {
+        if (changed(depthWrite, write ? 1u : 0u))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    // all four channels together, the renderer never masks them separately
+    void colorMask(bool write) {
+        GLboolean value = write ? GL_TRUE : GL_FALSE;
+        if (changed(colorWrite, write ? 1u : 0u))
+            glColorMask(value, value, value, value);
+    }
+
+    void viewport(int x, int y, int width, int height) {
+        unsigned int rect[4] = {(unsigned int)x, (unsigned int)y, (unsigned int)width, (unsigned int)height};
+        if (rect[0] == viewportRect[0] && rect[1] == viewportRect[1] &&
+            rect[2] == viewportRect[2] && rect[3] == viewportRect[3]) {
+            elided++;
+            return;
+        }
+        for (int i = 0; i < 4; i++)
+            viewportRect[i] = rect[i];
+        glViewport(x, y, width, height);
+        issued++;
+    }
+
+private:
+    static const unsigned int UNKNOWN = ~0u;
+    enum { TEXTURE_2D, TEXTURE_CUBE_MAP, TEXTURE_TARGETS };
+    enum { CAP_BLEND, CAP_CULL_FACE, CAP_DEPTH_TEST, CAPABILITIES };
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    unsigned int readFramebuffer;
+    unsigned int drawFramebuffer;
+    unsigned int capabilities[CAPABILITIES];
+    unsigned int cullFaceMode;
+    unsigned int depthFunction;
+    unsigned int depthWrite;
+    unsigned int colorWrite;
+    unsigned int viewportRect[4];
+
+    // updates the shadow value, true if the caller has to issue the GL call
+    bool changed(unsigned int &current, unsigned int value) {
+        if (current == value) {
+            elided++;
+            return false;
+        }
+        current = value;
+        issued++;
+        return true;
+    }
+
+    static int targetSlot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return TEXTURE_2D;
+            case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+            default: return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum cap) {
+        switch (cap) {
+            case GL_BLEND: return CAP_BLEND;
+            case GL_CULL_FACE: return CAP_CULL_FACE;
+            case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+            default: return -1;
+        }
+    }
+};
+
+// the one context this application renders with
+inline GLState &glState() {
+    static GLState state;
+    return state;
+}
+
+};
+#endif //PROJECT_BASE_GLSTATE_H
@@ -0,0 +1,179 @@
+//
+// Frustum culling of instances on the GPU, only used with rg::StaticScene, so only where indirect draws
+// exist. A compute shader compacts the surviving instances and counts them straight into the indirect
+// commands; on a GL 4.x context with indirect draws but no compute shaders a transform feedback pass
+// zeroes the culled transforms in place instead, without compacting. Visibility is never read back.
+//
+
+#ifndef PROJECT_BASE_GPUCULLING_H
+#define PROJECT_BASE_GPUCULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLExtensions.h>
+#include <rg/GLState.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace rg {
+
+// planes of a view-projection frustum, normals pointing inside and normalized, so
+// dot(plane.xyz, p) + plane.w is the signed distance of p
+inline void ExtractFrustumPlanes(const glm::mat4 &m, glm::vec4 planes[6]) {
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes[0] = row3 + row0;   // left
+    planes[1] = row3 - row0;   // right
+    planes[2] = row3 + row1;   // bottom
+    planes[3] = row3 - row1;   // top
+    planes[4] = row3 + row2;   // near
+    planes[5] = row3 - row2;   // far
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// buffers of one culling target (the camera, or the six faces of a shadow cube)
+struct CullBuffers {
+    // inputs, one element per instance
+    unsigned int transforms = 0;    // ObjectTransform
+    unsigned int bounds = 0;
+    unsigned int instanceCommands = 0;
+    unsigned int feedbackVAO = 0;   // transforms and bounds as vertex attributes, transform feedback only
+    GLuint instanceCount = 0;
+    // indirect commands the draws read; reset from commandTemplate (instance counts zeroed) before compaction
+    unsigned int commands = 0;
+    unsigned int commandTemplate = 0;
+    GLsizeiptr commandBytes = 0;
+    // per-instance transforms (ObjectTransform) the draws read
+    unsigned int culled = 0;
+};
+
+class GpuCulling {
+public:
+    enum Method {
+        CULL_UNAVAILABLE,
+        CULL_COMPUTE,
+        CULL_TRANSFORM_FEEDBACK
+    };
+    static const int MAX_FRUSTA = 6;
+
+    // compiles the culling program for the best method the context supports
+    Method init() {
+        if (glExtensions().computeShader) {
+            program = compile(GL_COMPUTE_SHADER, "resources/shaders/frustum_cull.comp", nullptr, 0);
+            method = program ? CULL_COMPUTE : CULL_UNAVAILABLE;
+        }
+        if (method == CULL_UNAVAILABLE) {
+            const char *varyings[] = {"culledModel", "culledNormalMatrix"};
+            program = compile(GL_VERTEX_SHADER, "resources/shaders/frustum_cull.vs", varyings, 2);
+            method = program ? CULL_TRANSFORM_FEEDBACK : CULL_UNAVAILABLE;
+        }
+        if (program) {
+            instanceCountLocation = glGetUniformLocation(program, "instanceCount");
+            frustumCountLocation = glGetUniformLocation(program, "frustumCount");
+            planesLocation = glGetUniformLocation(program, "planes");
+        }
+        return method;
+    }
+
+    Method active() const {
+        return method;
+    }
+
+    // instances outside all of the frusta are culled, frustumCount 0 keeps everything
+    void run(const CullBuffers &buffers, const glm::mat4 *viewProjections, int frustumCount) {
+        if (method == CULL_UNAVAILABLE || buffers.instanceCount == 0)
+            return;
+        glm::vec4 planes[MAX_FRUSTA * 6];
+        frustumCount = frustumCount < MAX_FRUSTA ? frustumCount : MAX_FRUSTA;
+        for (int frustum = 0; frustum < frustumCount; frustum++)
+            ExtractFrustumPlanes(viewProjections[frustum], planes + frustum * 6);
+
+        GLState &state = glState();
+        state.useProgram(program);
+        glUniform1i(frustumCountLocation, frustumCount);
+        if (frustumCount > 0)
+            glUniform4fv(planesLocation, frustumCount * 6, &planes[0][0]);
+
+        if (method == CULL_COMPUTE) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffers.commandTemplate);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.commands);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, buffers.commandBytes);
+            glUniform1ui(instanceCountLocation, buffers.instanceCount);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers.transforms);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers.bounds);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, buffers.instanceCommands);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffers.commands);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, buffers.culled);
+            glExtensions().DispatchCompute((buffers.instanceCount + 63) / 64, 1, 1);
+            // the draws read the counts as commands and the transforms as instanced attributes
+            glExtensions().MemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        } else {
+            // every instance stays in its command, culled ones with a zero transform
+            state.bindVertexArray(buffers.feedbackVAO);
+            glEnable(GL_RASTERIZER_DISCARD);
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers.culled);
+            glBeginTransformFeedback(GL_POINTS);
+            glDrawArrays(GL_POINTS, 0, buffers.instanceCount);
+            glEndTransformFeedback();
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+            glDisable(GL_RASTERIZER_DISCARD);
+        }
+    }
+
+private:
+    Method method = CULL_UNAVAILABLE;
+    unsigned int program = 0;
+    GLint instanceCountLocation = -1;
+    GLint frustumCountLocation = -1;
+    GLint planesLocation = -1;
+
+    // single-stage program; varying names make it a transform feedback program capturing them interleaved
+    static unsigned int compile(GLenum type, const char *path, const char *const *varyings, int varyingCount) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return 0;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        std::string code = stream.str();
+        const char *source = code.c_str();
+
+        GLchar infoLog[1024];
+        GLint success = GL_FALSE;
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << path << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            glDeleteShader(shader);
+            return 0;
+        }
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, shader);
+        if (varyingCount > 0)
+            glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(program);
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(program, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << path << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+};
+
+};
+#endif //PROJECT_BASE_GPUCULLING_H
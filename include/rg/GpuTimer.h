@@ -0,0 +1,133 @@
+//
+// GPU time of a span of commands, measured with GL_TIME_ELAPSED queries. Results are picked up a few
+// frames later once they are available, reading them never stalls the pipeline.
+//
+
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+class GpuTimer {
+public:
+    // queries in flight; a result older than this is dropped rather than waited for
+    static const int LATENCY = 4;
+
+    void init() {
+        glGenQueries(LATENCY, queries);
+    }
+
+    // only one GL_TIME_ELAPSED query can be active, timers must not nest or overlap
+    void begin() {
+        pending[current] = false;
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[current] = true;
+        current = (current + 1) % LATENCY;
+        collect();
+    }
+
+    // exponentially smoothed, 0 until the first result arrives
+    double milliseconds() const {
+        return average;
+    }
+
+    double lastMilliseconds() const {
+        return last;
+    }
+
+private:
+    GLuint queries[LATENCY] = {0, 0, 0, 0};
+    bool pending[LATENCY] = {false, false, false, false};
+    int current = 0;
+    double last = 0.0;
+    double average = 0.0;
+
+    void collect() {
+        for (int i = 0; i < LATENCY; i++) {
+            if (!pending[i])
+                continue;
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+            pending[i] = false;
+            last = nanoseconds / 1.0e6;
+            average = average == 0.0 ? last : average * 0.9 + last * 0.1;
+        }
+    }
+};
+
+// GPU time between two timestamps, for a span that has GpuTimers inside it (the whole frame); timestamps
+// don't take the one GL_TIME_ELAPSED slot
+class GpuFrameTimer {
+public:
+    static const int LATENCY = GpuTimer::LATENCY;
+
+    void init() {
+        glGenQueries(2 * LATENCY, queries);
+    }
+
+    void begin() {
+        pending[current] = false;
+        glQueryCounter(queries[2 * current], GL_TIMESTAMP);
+    }
+
+    void end() {
+        glQueryCounter(queries[2 * current + 1], GL_TIMESTAMP);
+        pending[current] = true;
+        current = (current + 1) % LATENCY;
+        collect();
+    }
+
+    // exponentially smoothed, 0 until the first result arrives
+    double milliseconds() const {
+        return average;
+    }
+
+    double lastMilliseconds() const {
+        return last;
+    }
+
+    // results collected so far; lastMilliseconds() is a new measurement whenever this changed
+    unsigned long sampleCount() const {
+        return samples;
+    }
+
+private:
+    GLuint queries[2 * LATENCY] = {0, 0, 0, 0, 0, 0, 0, 0};
+    bool pending[LATENCY] = {false, false, false, false};
+    int current = 0;
+    double last = 0.0;
+    double average = 0.0;
+    unsigned long samples = 0;
+
+    void collect() {
+        for (int i = 0; i < LATENCY; i++) {
+            if (!pending[i])
+                continue;
+            // the end stamp is written after the begin stamp, once it is there both are
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(queries[2 * i + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[2 * i], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            pending[i] = false;
+            last = (end - begin) / 1.0e6;
+            average = average == 0.0 ? last : average * 0.9 + last * 0.1;
+            samples++;
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_GPUTIMER_H
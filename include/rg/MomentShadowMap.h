@@ -0,0 +1,109 @@
+//
+// Variance shadow cube of a point light. After every shadow update the depth cube is resampled into
+// (depth, depth^2) moments at a lower resolution and blurred with a separable Gaussian, face by face, so
+// the lighting needs one filtered lookup and Chebyshev's bound instead of a PCF kernel.
+//
+
+#ifndef PROJECT_BASE_MOMENTSHADOWMAP_H
+#define PROJECT_BASE_MOMENTSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/Fullscreen.h>
+#include <rg/GLState.h>
+
+namespace rg {
+
+class MomentShadowMap {
+public:
+    // taps each side of the blur
+    int blurRadius = 3;
+    // lighting parameters: the variance floor against acne, and the part of Chebyshev's bound cut off
+    // against light bleeding where casters overlap
+    float minVariance = 0.00002f;
+    float bleedReduction = 0.3f;
+
+    void init(unsigned int size) {
+        resolution = size;
+        // horizontal pass, one layer per face, read back texel by texel
+        glGenTextures(1, &scratch);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, scratch);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, resolution, resolution, 6, 0, GL_RG, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        // the moments have to be filterable, that is the point of them; 32-bit because depth^2 loses
+        // everything in 16
+        glGenTextures(1, &cube);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+        for (unsigned int i = 0; i < 6; ++i)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RG32F, resolution, resolution, 0, GL_RG, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        for (int face = 0; face < 6; face++) {
+            glGenFramebuffers(1, &scratchFBO[face]);
+            glBindFramebuffer(GL_FRAMEBUFFER, scratchFBO[face]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, scratch, 0, face);
+            glGenFramebuffers(1, &cubeFBO[face]);
+            glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO[face]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cube, 0);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // the cube the lighting samples (SHADOW_MOMENTS variant)
+    unsigned int texture() const {
+        return cube;
+    }
+
+    unsigned int size() const {
+        return resolution;
+    }
+
+    // rebuilds the moments from a depth cube holding distance / far_plane; shader is shadow_moments, its
+    // FROM_DEPTH variant runs the horizontal pass; unit is a texture unit no compare sampler is bound to
+    void filter(unsigned int depthCube, Shader &shader, unsigned int fromDepthVariant, unsigned int unit) {
+        GLState &state = glState();
+        state.viewport(0, 0, resolution, resolution);
+
+        shader.select(fromDepthVariant);
+        shader.use();
+        shader.setInt("depthMap", unit);
+        shader.setInt("radius", blurRadius);
+        shader.setFloat("resolution", (float)resolution);
+        state.bindTexture(unit, GL_TEXTURE_CUBE_MAP, depthCube);
+        for (int face = 0; face < 6; face++) {
+            state.bindFramebuffer(GL_FRAMEBUFFER, scratchFBO[face]);
+            shader.setInt("face", face);
+            DrawFullscreenTriangle();
+        }
+
+        shader.select(0);
+        shader.use();
+        shader.setInt("horizontal", unit);
+        shader.setInt("radius", blurRadius);
+        state.bindTexture(unit, GL_TEXTURE_2D_ARRAY, scratch);
+        for (int face = 0; face < 6; face++) {
+            state.bindFramebuffer(GL_FRAMEBUFFER, cubeFBO[face]);
+            shader.setInt("face", face);
+            DrawFullscreenTriangle();
+        }
+    }
+
+private:
+    unsigned int resolution = 0;
+    unsigned int scratch = 0;
+    unsigned int cube = 0;
+    unsigned int scratchFBO[6] = {0, 0, 0, 0, 0, 0};
+    unsigned int cubeFBO[6] = {0, 0, 0, 0, 0, 0};
+};
+
+};
+#endif //PROJECT_BASE_MOMENTSHADOWMAP_H
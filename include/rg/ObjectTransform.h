@@ -0,0 +1,127 @@
+//
+// Per-object transform data as the shaders read it: the model matrix and the normal matrix
+// transpose(inverse(mat3(model))), computed once per object on the CPU instead of per vertex.
+// Objects are processed in one batch, four at a time with SSE where the compiler targets it.
+//
+
+#ifndef PROJECT_BASE_OBJECTTRANSFORM_H
+#define PROJECT_BASE_OBJECTTRANSFORM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RG_OBJECT_TRANSFORM_SSE 1
+#endif
+
+namespace rg {
+
+// matches 'mat4 model; mat3 normalMatrix;' in std140 and std430 (a mat3 is three vec4-aligned columns)
+struct ObjectTransform {
+    glm::mat4 model;
+    glm::vec4 normal[3];
+};
+
+namespace detail {
+
+// columns of transpose(inverse(A)) for A = (a0 a1 a2) are (a1 x a2, a2 x a0, a0 x a1) / det(A)
+inline void NormalMatrix(const glm::mat4 &model, glm::vec4 normal[3]) {
+    const float *a0 = &model[0][0];
+    const float *a1 = &model[1][0];
+    const float *a2 = &model[2][0];
+    float d0 = a0[0] * a0[0] + a0[1] * a0[1] + a0[2] * a0[2];
+    float d1 = a1[0] * a1[0] + a1[1] * a1[1] + a1[2] * a1[2];
+    float d2 = a2[0] * a2[0] + a2[1] * a2[1] + a2[2] * a2[2];
+    float o01 = a0[0] * a1[0] + a0[1] * a1[1] + a0[2] * a1[2];
+    float o12 = a1[0] * a2[0] + a1[1] * a2[1] + a1[2] * a2[2];
+    float o20 = a2[0] * a0[0] + a2[1] * a0[1] + a2[2] * a0[2];
+    const float epsilon = 1e-5f * d0;
+    // rotation times uniform scale s: the inverse transpose is the matrix itself divided by s^2
+    if (std::fabs(d1 - d0) <= epsilon && std::fabs(d2 - d0) <= epsilon &&
+        std::fabs(o01) <= epsilon && std::fabs(o12) <= epsilon && std::fabs(o20) <= epsilon) {
+        float inverseScale = d0 > 0.0f ? 1.0f / d0 : 0.0f;
+        for (int column = 0; column < 3; column++)
+            normal[column] = glm::vec4(model[column][0] * inverseScale, model[column][1] * inverseScale,
+                                       model[column][2] * inverseScale, 0.0f);
+        return;
+    }
+    float c0[3] = {a1[1] * a2[2] - a1[2] * a2[1], a1[2] * a2[0] - a1[0] * a2[2], a1[0] * a2[1] - a1[1] * a2[0]};
+    float c1[3] = {a2[1] * a0[2] - a2[2] * a0[1], a2[2] * a0[0] - a2[0] * a0[2], a2[0] * a0[1] - a2[1] * a0[0]};
+    float c2[3] = {a0[1] * a1[2] - a0[2] * a1[1], a0[2] * a1[0] - a0[0] * a1[2], a0[0] * a1[1] - a0[1] * a1[0]};
+    float det = a0[0] * c0[0] + a0[1] * c0[1] + a0[2] * c0[2];
+    float inverseDet = std::fabs(det) > 1e-20f ? 1.0f / det : 0.0f;
+    normal[0] = glm::vec4(c0[0] * inverseDet, c0[1] * inverseDet, c0[2] * inverseDet, 0.0f);
+    normal[1] = glm::vec4(c1[0] * inverseDet, c1[1] * inverseDet, c1[2] * inverseDet, 0.0f);
+    normal[2] = glm::vec4(c2[0] * inverseDet, c2[1] * inverseDet, c2[2] * inverseDet, 0.0f);
+}
+
+#ifdef RG_OBJECT_TRANSFORM_SSE
+// four objects at once, structure of arrays: every register holds one matrix element of four objects;
+// the cofactor form is cheap enough that the uniform-scale shortcut would only cost a branch per lane
+inline void NormalMatrices4(const glm::mat4 *models[4], glm::vec4 *normals[4]) {
+    __m128 a[3][3];
+    for (int column = 0; column < 3; column++)
+        for (int row = 0; row < 3; row++)
+            a[column][row] = _mm_set_ps((*models[3])[column][row], (*models[2])[column][row],
+                                        (*models[1])[column][row], (*models[0])[column][row]);
+
+    // cofactor columns, cross products of the other two columns
+    __m128 c[3][3];
+    for (int column = 0; column < 3; column++) {
+        const __m128 *u = a[(column + 1) % 3];
+        const __m128 *v = a[(column + 2) % 3];
+        c[column][0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+        c[column][1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+        c[column][2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+    }
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0][0], c[0][0]), _mm_mul_ps(a[0][1], c[0][1])),
+                            _mm_mul_ps(a[0][2], c[0][2]));
+    // singular matrices (a zero scale) get a zero normal matrix instead of infinities
+    __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 invertible = _mm_cmpgt_ps(magnitude, _mm_set1_ps(1e-20f));
+    __m128 inverseDet = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), det), invertible);
+
+    alignas(16) float lanes[4];
+    for (int column = 0; column < 3; column++)
+        for (int row = 0; row < 3; row++) {
+            _mm_store_ps(lanes, _mm_mul_ps(c[column][row], inverseDet));
+            for (int object = 0; object < 4; object++)
+                normals[object][column][row] = lanes[object];
+        }
+    for (int object = 0; object < 4; object++)
+        for (int column = 0; column < 3; column++)
+            normals[object][column][3] = 0.0f;
+}
+#endif
+
+};
+
+// fills out[i] with models[i] and its normal matrix, for count objects
+inline void ComputeObjectTransforms(const glm::mat4 *models, ObjectTransform *out, size_t count) {
+    size_t i = 0;
+#ifdef RG_OBJECT_TRANSFORM_SSE
+    for (; i + 4 <= count; i += 4) {
+        const glm::mat4 *batch[4] = {&models[i], &models[i + 1], &models[i + 2], &models[i + 3]};
+        glm::vec4 *normals[4] = {out[i].normal, out[i + 1].normal, out[i + 2].normal, out[i + 3].normal};
+        detail::NormalMatrices4(batch, normals);
+        for (int object = 0; object < 4; object++)
+            out[i + object].model = models[i + object];
+    }
+#endif
+    for (; i < count; i++) {
+        out[i].model = models[i];
+        detail::NormalMatrix(models[i], out[i].normal);
+    }
+}
+
+inline ObjectTransform MakeObjectTransform(const glm::mat4 &model) {
+    ObjectTransform transform;
+    ComputeObjectTransforms(&model, &transform, 1);
+    return transform;
+}
+
+};
+#endif //PROJECT_BASE_OBJECTTRANSFORM_H
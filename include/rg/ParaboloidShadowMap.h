@@ -0,0 +1,82 @@
+//
+// Dual-paraboloid shadow of a point light: two hemispheres around the light's down and up axis, each a
+// single depth layer the vertex shader projects into (PARABOLOID variant of point_shadows.vs). Two views
+// per update instead of six, paid for with curved edges on coarse geometry near the equator.
+//
+
+#ifndef PROJECT_BASE_PARABOLOIDSHADOWMAP_H
+#define PROJECT_BASE_PARABOLOIDSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLState.h>
+
+namespace rg {
+
+class ParaboloidShadowMap {
+public:
+    // layer 0 looks down (-y), layer 1 up (+y)
+    static const int HEMISPHERES = 2;
+
+    void init(unsigned int size) {
+        resolution = size;
+        glGenTextures(1, &layers);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layers);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, resolution, resolution, HEMISPHERES, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        // only ever read through sampler2DArrayShadow, so the compare lives on the texture
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        for (int hemisphere = 0; hemisphere < HEMISPHERES; hemisphere++) {
+            glGenFramebuffers(1, &fbo[hemisphere]);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo[hemisphere]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, layers, 0, hemisphere);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // the layers the lighting samples (SHADOW_PARABOLOID variant)
+    unsigned int texture() const {
+        return layers;
+    }
+
+    unsigned int size() const {
+        return resolution;
+    }
+
+    // bit h set if a sphere (world center, radius) reaches into hemisphere h of a light at lightPos
+    static unsigned int HemisphereMask(const glm::vec3 &lightPos, const glm::vec4 &sphere, float farPlane) {
+        glm::vec3 d = glm::vec3(sphere) - lightPos;
+        if (glm::length(d) > farPlane + sphere.w)
+            return 0;
+        unsigned int mask = 0;
+        if (d.y <= sphere.w)
+            mask |= 1u;
+        if (d.y >= -sphere.w)
+            mask |= 2u;
+        return mask;
+    }
+
+    // binds and clears one hemisphere; draw the casters with the hemisphere uniform set after this
+    void begin(int hemisphere) {
+        GLState &state = glState();
+        state.viewport(0, 0, resolution, resolution);
+        state.bindFramebuffer(GL_FRAMEBUFFER, fbo[hemisphere]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+private:
+    unsigned int resolution = 0;
+    unsigned int layers = 0;
+    unsigned int fbo[HEMISPHERES] = {0, 0};
+};
+
+};
+#endif //PROJECT_BASE_PARABOLOIDSHADOWMAP_H
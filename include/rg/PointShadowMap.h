@@ -0,0 +1,217 @@
+//
+// Depth cube of a point light with the static casters cached. The static cube is redrawn only when the
+// light has moved further than refreshDistance from where it was last drawn; every frame it is copied
+// into the cube the lighting samples and the dynamic casters are drawn on top. Both are rendered from the
+// cached light position, so static and dynamic depths always agree.
+//
+
+#ifndef PROJECT_BASE_POINTSHADOWMAP_H
+#define PROJECT_BASE_POINTSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLExtensions.h>
+#include <rg/GLState.h>
+
+#include <cmath>
+
+namespace rg {
+
+// how the casters reach the six faces
+enum ShadowMethod {
+    SHADOW_GEOMETRY_SHADER,   // point_shadows.gs copies every triangle to all six layers
+    SHADOW_PER_FACE,          // one pass per face, only the casters inside it (SHADOW_FACE variant)
+    SHADOW_VERTEX_LAYER,      // one instance per touched face, gl_Layer from the vertex shader (VERTEX_LAYER)
+    SHADOW_METHOD_COUNT
+};
+const unsigned int ALL_CUBE_FACES = 0x3F;
+
+// how the lighting filters the cube, each tier is a variant of 2.model_lighting.fs
+enum ShadowQuality {
+    SHADOW_QUALITY_REFERENCE,   // 20 nearest taps with a compare in the shader
+    SHADOW_QUALITY_LOW,         // SHADOW_COMPARE: one hardware compare tap, 2x2 PCF
+    SHADOW_QUALITY_MEDIUM,      // SHADOW_COMPARE: 4 probe taps, up to 8 inside penumbrae
+    SHADOW_QUALITY_HIGH,        // SHADOW_COMPARE: 4 probe taps, up to 20 inside penumbrae
+    SHADOW_QUALITY_VARIANCE,    // SHADOW_MOMENTS: one lookup into the prefiltered moments (rg::MomentShadowMap)
+    SHADOW_QUALITY_PARABOLOID,  // SHADOW_PARABOLOID: two hemispheres instead of the cube (rg::ParaboloidShadowMap)
+    SHADOW_QUALITY_COUNT
+};
+
+// shadowSamples of a tier, the shader lowers it with distance
+inline int ShadowQualitySamples(ShadowQuality quality) {
+    switch (quality) {
+        case SHADOW_QUALITY_LOW:
+        case SHADOW_QUALITY_VARIANCE:
+        case SHADOW_QUALITY_PARABOLOID:
+            return 1;
+        case SHADOW_QUALITY_MEDIUM:
+            return 8;
+        default:
+            return 20;
+    }
+}
+
+class PointShadowMap {
+public:
+    // light movement (world units) the cached static depth tolerates
+    float refreshDistance = 0.25f;
+    // how often the static casters had to be redrawn
+    unsigned long staticRefreshes = 0;
+
+    void init(unsigned int size) {
+        resolution = size;
+        cube = createCube();
+        staticCube = createCube();
+        fbo = createFramebuffer(cube);
+        staticFBO = createFramebuffer(staticCube);
+        for (int face = 0; face < 6; face++) {
+            faceFBO[face] = createFramebuffer(cube, face);
+            staticFaceFBO[face] = createFramebuffer(staticCube, face);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        // depth compare and linear filtering as a sampler object, the cube itself stays NEAREST for the
+        // reference path and the copies
+        glGenSamplers(1, &shadowSampler);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(shadowSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+
+    // bound to the cube's unit for samplerCubeShadow lookups
+    unsigned int compareSampler() const {
+        return shadowSampler;
+    }
+
+    // the cube the lighting samples
+    unsigned int texture() const {
+        return cube;
+    }
+
+    unsigned int size() const {
+        return resolution;
+    }
+
+    // true if the static casters have to be redrawn for a light at lightPos; the cached position then
+    // moves there
+    bool update(const glm::vec3 &lightPos) {
+        if (valid && glm::length(lightPos - cachedLight) <= refreshDistance)
+            return false;
+        cachedLight = lightPos;
+        valid = true;
+        staticRefreshes++;
+        return true;
+    }
+
+    // where the shadow is rendered from, for the shadow matrices and the lookups
+    glm::vec3 lightPosition() const {
+        return cachedLight;
+    }
+
+    void invalidate() {
+        valid = false;
+    }
+
+    static bool supported(ShadowMethod method) {
+        return method != SHADOW_VERTEX_LAYER || glExtensions().vertexShaderLayer;
+    }
+
+    // bit f set if a sphere (world center, radius) reaches into face f of a cube at lightPos; a face is the
+    // 90 degree pyramid along +-x, +-y, +-z, so each side plane is a diagonal through two axes
+    static unsigned int FaceMask(const glm::vec3 &lightPos, const glm::vec4 &sphere, float farPlane) {
+        const float diagonal = 0.70710678f;
+        glm::vec3 d = glm::vec3(sphere) - lightPos;
+        float radius = sphere.w;
+        unsigned int mask = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+            for (int side = 0; side < 2; side++) {
+                float along = side == 0 ? d[axis] : -d[axis];
+                if (along < -radius || along > farPlane + radius)
+                    continue;
+                if ((along - std::fabs(d[u])) * diagonal >= -radius && (along - std::fabs(d[v])) * diagonal >= -radius)
+                    mask |= 1u << (axis * 2 + side);
+            }
+        }
+        return mask;
+    }
+
+    // binds the static or the sampled cube, all six layers or a single face (face >= 0)
+    void bind(bool staticCube, int face = -1) {
+        GLState &state = glState();
+        state.viewport(0, 0, resolution, resolution);
+        if (face < 0)
+            state.bindFramebuffer(GL_FRAMEBUFFER, staticCube ? staticFBO : fbo);
+        else
+            state.bindFramebuffer(GL_FRAMEBUFFER, staticCube ? staticFaceFBO[face] : faceFBO[face]);
+    }
+
+    // binds and clears the static cube (all layers); draw the static casters after this
+    void beginStatic() {
+        bind(true);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // starts the sampled cube from the cached static depth and binds it; draw the dynamic casters after this
+    void beginDynamic() {
+        GLState &state = glState();
+        if (glExtensions().copyImage) {
+            glExtensions().CopyImageSubData(staticCube, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0,
+                                            cube, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, resolution, resolution, 6);
+        } else {
+            // GL 3.3: one depth blit per face
+            for (int face = 0; face < 6; face++) {
+                state.bindFramebuffer(GL_READ_FRAMEBUFFER, staticFaceFBO[face]);
+                state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, faceFBO[face]);
+                glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            }
+        }
+        bind(false);
+    }
+
+private:
+    unsigned int resolution = 0;
+    unsigned int cube = 0, staticCube = 0;
+    unsigned int fbo = 0, staticFBO = 0;
+    unsigned int faceFBO[6] = {0, 0, 0, 0, 0, 0};
+    unsigned int staticFaceFBO[6] = {0, 0, 0, 0, 0, 0};
+    unsigned int shadowSampler = 0;
+    bool valid = false;
+    glm::vec3 cachedLight = glm::vec3(0.0f);
+
+    unsigned int createCube() const {
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+        for (unsigned int i = 0; i < 6; ++i)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return id;
+    }
+
+    // all six faces attached as layers (the shader picks the face through gl_Layer), or a single face
+    static unsigned int createFramebuffer(unsigned int depthCube, int face = -1) {
+        unsigned int id;
+        glGenFramebuffers(1, &id);
+        glBindFramebuffer(GL_FRAMEBUFFER, id);
+        if (face < 0)
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCube, 0);
+        else
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, depthCube, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return id;
+    }
+};
+
+};
+#endif //PROJECT_BASE_POINTSHADOWMAP_H
@@ -0,0 +1,117 @@
+//
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+//
+
+#ifndef PROJECT_BASE_PROGRAMBINARYCACHE_H
+#define PROJECT_BASE_PROGRAMBINARYCACHE_H
+
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace rg {
+
+class ProgramBinaryCache {
+public:
+    // empty directory disables the cache
+    static std::string &directory() {
+        static std::string dir;
+        return dir;
+    }
+
+    static void enable(const std::string &dir) {
+        directory() = dir;
+        mkdir(dir.c_str(), 0755);
+    }
+
+    static bool enabled() {
+        return !directory().empty() && glExtensions().programBinary;
+    }
+
+    // FNV-1a over everything that can change the linked program: all sources with their injected defines
+    // and the driver identity, a driver update invalidates the whole cache
+    static uint64_t key(const std::vector<const std::string *> &sources) {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const std::string &text) {
+            for (unsigned char c : text) {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            hash ^= 0xff;   // separator, so "ab"+"c" and "a"+"bc" differ
+            hash *= 1099511628211ull;
+        };
+        for (const std::string *source : sources)
+            mix(*source);
+        const GLExtensions &ext = glExtensions();
+        mix(ext.vendor);
+        mix(ext.renderer);
+        mix(ext.version);
+        return hash;
+    }
+
+    // must be called before glLinkProgram for the driver to keep a retrievable binary
+    static void prepareForLink(unsigned int program) {
+        if (enabled())
+            glExtensions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // true if the program was loaded from the cache and linked successfully;
+    // a missing, stale or rejected binary returns false and the caller compiles from source
+    static bool load(uint64_t key, unsigned int program) {
+        if (!enabled())
+            return false;
+        std::ifstream in(path(key), std::ios::binary);
+        if (!in)
+            return false;
+        GLenum format = 0;
+        GLint length = 0;
+        in.read((char *)&format, sizeof(format));
+        in.read((char *)&length, sizeof(length));
+        if (!in || length <= 0)
+            return false;
+        std::vector<char> binary(length);
+        in.read(binary.data(), length);
+        if (!in)
+            return false;
+
+        glExtensions().ProgramBinary(program, format, binary.data(), length);
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+            std::remove(path(key).c_str());
+        return success == GL_TRUE;
+    }
+
+    static void store(uint64_t key, unsigned int program) {
+        if (!enabled())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glExtensions().GetProgramBinary(program, length, &length, &format, binary.data());
+
+        std::ofstream out(path(key), std::ios::binary | std::ios::trunc);
+        out.write((const char *)&format, sizeof(format));
+        out.write((const char *)&length, sizeof(length));
+        out.write(binary.data(), length);
+    }
+
+private:
+    static std::string path(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory() + "/" + name;
+    }
+};
+
+};
+#endif //PROJECT_BASE_PROGRAMBINARYCACHE_H
@@ -0,0 +1,222 @@
+//
+// Sort-keyed draw queue: meshes are submitted as packets, radix sorted by a 64-bit key and
+// executed in that order, so consecutive draws share as much state as possible.
+//
+
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLState.h>
+#include <rg/ObjectTransform.h>
+#include <rg/RingBuffer.h>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/material.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+// passes in execution order, the top bits of every key
+enum RenderPass {
+    PASS_STATIC_SHADOW,   // static casters, only when the cached shadow is redrawn (rg::PointShadowMap)
+    PASS_SHADOW,
+    PASS_ATLAS_SHADOW,    // the secondary lights' cubes, one view bit per slot face (rg::ShadowAtlas)
+    PASS_DEPTH_PREPASS,
+    PASS_OPAQUE,
+    PASS_BLENDED,
+    RENDER_PASS_COUNT
+};
+
+inline unsigned int BlendMask(BlendMode mode) {
+    return 1u << mode;
+}
+const unsigned int ALL_BLEND_MODES = (1u << BLEND_OPAQUE) | (1u << BLEND_CUTOUT) | (1u << BLEND_BLENDED);
+
+struct DrawPacket {
+    Mesh *mesh;
+    unsigned int program;
+    ObjectTransform transform;
+    glm::mat4 previousModel;   // last frame's model matrix, for the velocity
+    uint32_t viewMask;   // views (e.g. cube faces) the packet is visible in
+};
+const uint32_t ALL_VIEWS = ~0u;
+
+// ObjectData as the shaders read it. std140 rounds the block up to 16 bytes and a range bound with
+// glBindBufferRange must cover all of it, so viewMask is padded out to the next 16-byte boundary, where
+// previousModel starts
+struct ObjectData {
+    ObjectTransform transform;
+    uint32_t viewMask;
+    uint32_t padding[3];
+    glm::mat4 previousModel;
+};
+static_assert(sizeof(ObjectData) % 16 == 0, "ObjectData must be a whole number of std140 vec4s");
+
+class RenderQueue {
+public:
+    // distances are quantized over [0, depthRange]
+    float depthRange = 100.0f;
+
+    // per-draw data is written into the ring's current frame
+    explicit RenderQueue(RingBuffer &ring) : ring(ring) {
+    }
+
+    void clear() {
+        packets.clear();
+        items.clear();
+    }
+
+    // previousModel is only read by the velocity variants, nullptr: the object did not move
+    void submit(RenderPass pass, Shader &shader, Mesh &mesh, const ObjectTransform &transform, float depth,
+                uint32_t viewMask = ALL_VIEWS, const glm::mat4 *previousModel = nullptr) {
+        unsigned int program = shader.program();
+        items.push_back({makeKey(pass, program, mesh.material, depth), (uint32_t)packets.size()});
+        packets.push_back({&mesh, program, transform, previousModel ? *previousModel : transform.model, viewMask});
+    }
+
+    // every mesh of the model whose blend mode is in blendModes (see BlendMask)
+    void submit(RenderPass pass, Shader &shader, Model &model, const ObjectTransform &transform, float depth,
+                unsigned int blendModes = ALL_BLEND_MODES, uint32_t viewMask = ALL_VIEWS,
+                const glm::mat4 *previousModel = nullptr) {
+        for (Mesh &mesh : model.meshes)
+            if (blendModes & BlendMask(mesh.material.blendMode))
+                submit(pass, shader, mesh, transform, depth, viewMask, previousModel);
+    }
+
+    // LSD radix sort, 8 bits per digit; digits every key shares are skipped, so in practice only
+    // the few bytes that actually vary (pass, program, material, depth) cost a scatter
+    void sort() {
+        size_t count = items.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+
+        size_t histograms[8][256];
+        std::memset(histograms, 0, sizeof(histograms));
+        for (const SortItem &item : items)
+            for (int digit = 0; digit < 8; digit++)
+                histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+
+        for (int digit = 0; digit < 8; digit++) {
+            size_t *histogram = histograms[digit];
+            if (histogram[(items[0].key >> (digit * 8)) & 0xFF] == count)
+                continue;
+            size_t offset = 0;
+            for (int bucket = 0; bucket < 256; bucket++) {
+                size_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+            for (const SortItem &item : items)
+                scratch[histogram[(item.key >> (digit * 8)) & 0xFF]++] = item;
+            items.swap(scratch);
+        }
+    }
+
+    // draws one pass of the sorted queue; per-pass uniform blocks must already be bound, each packet's
+    // ObjectData is written into the ring in one go and bound per draw. Only packets visible in one of
+    // views are drawn; layered draws every packet once per view it is visible in, as instances the
+    // shader maps to layers through ObjectData.viewMask
+    void execute(RenderPass pass, uint32_t views = ALL_VIEWS, bool layered = false) {
+        auto first = std::lower_bound(items.begin(), items.end(), pass, [](const SortItem &item, int p) {
+            return (int)(item.key >> PASS_SHIFT) < p;
+        });
+        auto last = std::upper_bound(first, items.end(), pass, [](int p, const SortItem &item) {
+            return p < (int)(item.key >> PASS_SHIFT);
+        });
+
+        if (first == last)
+            return;
+        GLintptr stride = (sizeof(ObjectData) + ring.uniformOffsetAlignment() - 1) / ring.uniformOffsetAlignment() * ring.uniformOffsetAlignment();
+        GLintptr base = 0;
+        unsigned char *objects = (unsigned char *)ring.map((last - first) * stride, ring.uniformOffsetAlignment(), &base);
+        if (!objects)
+            return;
+        for (auto it = first; it != last; ++it) {
+            const DrawPacket &packet = packets[it->packet];
+            ObjectData data = {packet.transform, packet.viewMask & views, {0, 0, 0}, packet.previousModel};
+            std::memcpy(objects + (it - first) * stride, &data, sizeof(ObjectData));
+        }
+        ring.unmap();
+
+        GLState &state = glState();
+        unsigned int program = 0;
+        const Material *material = nullptr;
+        for (auto it = first; it != last; ++it) {
+            DrawPacket &packet = packets[it->packet];
+            uint32_t visible = packet.viewMask & views;
+            if (!visible)
+                continue;
+            if (packet.program != program) {
+                program = packet.program;
+                state.useProgram(program);
+                material = nullptr;
+            }
+            // sorted packets of one material are adjacent, its binds and cull state are set once
+            Material &meshMaterial = packet.mesh->material;
+            if (&meshMaterial != material) {
+                meshMaterial.applyCullState();
+                meshMaterial.bind(program);
+                material = &meshMaterial;
+            }
+            glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK, ring.buffer(), base + (it - first) * stride, sizeof(ObjectData));
+            state.bindVertexArray(packet.mesh->VAO);
+            if (layered)
+                glDrawElementsInstanced(GL_TRIANGLES, packet.mesh->indices.size(), GL_UNSIGNED_INT, 0, BitCount(visible));
+            else
+                glDrawElements(GL_TRIANGLES, packet.mesh->indices.size(), GL_UNSIGNED_INT, 0);
+        }
+    }
+
+    size_t size() const {
+        return packets.size();
+    }
+
+private:
+    struct SortItem {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    // key layout, most significant first
+    //   opaque passes: pass(4) | state(4) | program(12) | material(20) | depth(24)   state changes first, then front to back
+    //   blended pass:  pass(4) | ~depth(24) | state(4) | program(12) | material(20)  back to front
+    static const int PASS_SHIFT = 60;
+
+    std::vector<DrawPacket> packets;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    RingBuffer &ring;
+
+    static int BitCount(uint32_t bits) {
+        int count = 0;
+        for (; bits; bits &= bits - 1)
+            count++;
+        return count;
+    }
+
+    uint64_t makeKey(RenderPass pass, unsigned int program, const Material &material, float depth) const {
+        uint64_t state = (uint64_t)material.cullMode | ((uint64_t)material.alphaTest << 2);
+        uint64_t programBits = program & 0xFFF;
+        // meshes sharing a diffuse texture share everything expensive to bind
+        uint64_t materialBits = material.textures[UNIT_DIFFUSE] & 0xFFFFF;
+        float normalized = std::min(std::max(depth / depthRange, 0.0f), 1.0f);
+        uint64_t depthBits = (uint64_t)(normalized * 0xFFFFFF);
+
+        uint64_t key = (uint64_t)pass << PASS_SHIFT;
+        if (pass == PASS_BLENDED)
+            return key | ((0xFFFFFF - depthBits) << 36) | (state << 32) | (programBits << 20) | materialBits;
+        return key | (state << 56) | (programBits << 44) | (materialBits << 24) | depthBits;
+    }
+};
+
+};
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -0,0 +1,208 @@
+//
+// Screen-sized render targets, handed out by descriptor (format, size, usage) instead of being owned by
+// the passes. A target released at the end of a frame is handed out again to the next request with the
+// same descriptor, so steady frames allocate nothing; after a resize the new size is allocated on first
+// request and the old targets are deleted once they have gone unused for a few frames.
+//
+
+#ifndef PROJECT_BASE_RENDERTARGETPOOL_H
+#define PROJECT_BASE_RENDERTARGETPOOL_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace rg {
+
+enum RenderTargetUsage {
+    TARGET_NEAREST = 0,        // sampled texel by texel, or only rendered to
+    TARGET_FILTERED = 1 << 0,  // sampled with bilinear filtering
+};
+
+struct RenderTargetDesc {
+    GLsizei width;
+    GLsizei height;
+    GLenum format;
+    unsigned int usage;
+
+    bool operator==(const RenderTargetDesc &other) const {
+        return width == other.width && height == other.height && format == other.format && usage == other.usage;
+    }
+};
+
+class RenderTargetPool {
+public:
+    // frames a free target survives unrequested before its memory goes back to the driver
+    static const unsigned long TRIM_FRAMES = 3;
+
+    // textures created since startup; flat while nothing resizes
+    unsigned long allocations = 0;
+
+    // called once per frame with the framebuffer size screen-relative requests are based on
+    void beginFrame(int width, int height) {
+        frame++;
+        screenWidth = std::max(width, 1);
+        screenHeight = std::max(height, 1);
+        trim();
+    }
+
+    int width() const {
+        return screenWidth;
+    }
+
+    int height() const {
+        return screenHeight;
+    }
+
+    // the screen size divided by divisor (at least 1x1)
+    RenderTargetDesc screen(GLenum format, unsigned int usage = TARGET_FILTERED, int divisor = 1) const {
+        return {std::max(screenWidth / divisor, 1), std::max(screenHeight / divisor, 1), format, usage};
+    }
+
+    // a texture matching desc, exclusively the caller's until release()
+    unsigned int acquire(const RenderTargetDesc &desc) {
+        for (Target &target : targets) {
+            if (!target.inUse && target.desc == desc) {
+                target.inUse = true;
+                target.lastUsed = frame;
+                return target.texture;
+            }
+        }
+        Target target;
+        target.desc = desc;
+        target.texture = create(desc);
+        target.inUse = true;
+        target.lastUsed = frame;
+        targets.push_back(target);
+        allocations++;
+        return target.texture;
+    }
+
+    // hands the texture back; its contents stay until the next acquire of the same descriptor
+    void release(unsigned int texture) {
+        for (Target &target : targets)
+            if (target.texture == texture)
+                target.inUse = false;
+    }
+
+    // a framebuffer with color (0: none) and depth (0: none) attached, cached while both textures live
+    unsigned int framebuffer(unsigned int color, unsigned int depth = 0) {
+        for (const Framebuffer &fb : framebuffers)
+            if (fb.color == color && fb.depth == depth)
+                return fb.id;
+        Framebuffer fb;
+        fb.color = color;
+        fb.depth = depth;
+        glGenFramebuffers(1, &fb.id);
+        GLState &state = glState();
+        state.bindFramebuffer(GL_FRAMEBUFFER, fb.id);
+        if (color) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        } else {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        if (depth)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        framebuffers.push_back(fb);
+        return fb.id;
+    }
+
+    // memory of every target the pool holds, in use or not
+    size_t bytes() const {
+        size_t total = 0;
+        for (const Target &target : targets)
+            total += (size_t)target.desc.width * target.desc.height * TexelBytes(target.desc.format);
+        return total;
+    }
+
+    size_t targetCount() const {
+        return targets.size();
+    }
+
+    // bytes per texel of the formats the renderer asks for
+    static size_t TexelBytes(GLenum format) {
+        switch (format) {
+            case GL_R8:
+                return 1;
+            case GL_RG16F:
+            case GL_R11F_G11F_B10F:
+            case GL_RGBA8:
+            case GL_DEPTH_COMPONENT24:   // padded to 32 bits
+            case GL_DEPTH_COMPONENT32F:
+                return 4;
+            case GL_RGB16F:   // padded to four channels by every driver
+            case GL_RGBA16F:
+                return 8;
+            default:
+                return 16;
+        }
+    }
+
+    static bool IsDepthFormat(GLenum format) {
+        return format == GL_DEPTH_COMPONENT || format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 ||
+               format == GL_DEPTH_COMPONENT32F;
+    }
+
+private:
+    struct Target {
+        RenderTargetDesc desc;
+        unsigned int texture = 0;
+        bool inUse = false;
+        unsigned long lastUsed = 0;
+    };
+    struct Framebuffer {
+        unsigned int id = 0;
+        unsigned int color = 0;
+        unsigned int depth = 0;
+    };
+    std::vector<Target> targets;
+    std::vector<Framebuffer> framebuffers;
+    unsigned long frame = 0;
+    int screenWidth = 1, screenHeight = 1;
+
+    static unsigned int create(const RenderTargetDesc &desc) {
+        unsigned int id;
+        glGenTextures(1, &id);
+        // through the cache, the pool allocates in the middle of a frame
+        glState().bindTexture(0, GL_TEXTURE_2D, id);
+        GLenum layout = IsDepthFormat(desc.format) ? GL_DEPTH_COMPONENT : GL_RGBA;
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, layout, GL_FLOAT, nullptr);
+        GLint filter = (desc.usage & TARGET_FILTERED) ? GL_LINEAR : GL_NEAREST;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return id;
+    }
+
+    // deletes free targets nobody asked for in TRIM_FRAMES frames, with the framebuffers using them
+    void trim() {
+        GLState &state = glState();
+        for (size_t i = 0; i < targets.size();) {
+            Target &target = targets[i];
+            if (target.inUse || frame - target.lastUsed <= TRIM_FRAMES) {
+                i++;
+                continue;
+            }
+            for (size_t j = 0; j < framebuffers.size();) {
+                if (framebuffers[j].color == target.texture || framebuffers[j].depth == target.texture) {
+                    state.forgetFramebuffer(framebuffers[j].id);
+                    glDeleteFramebuffers(1, &framebuffers[j].id);
+                    framebuffers.erase(framebuffers.begin() + j);
+                } else {
+                    j++;
+                }
+            }
+            state.forgetTexture(target.texture);
+            glDeleteTextures(1, &target.texture);
+            targets.erase(targets.begin() + i);
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_RENDERTARGETPOOL_H
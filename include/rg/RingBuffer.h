@@ -0,0 +1,242 @@
+//
+// Per-frame streaming memory: one buffer split into FRAMES regions, each guarded by a fence. The CPU writes
+// the current frame's data straight into GPU-visible memory while the GPU still reads the previous ones.
+// A frame that outgrows its region takes the rest from a spare buffer and the ring grows at the next frame,
+// so nothing a frame handed out is overwritten and the fences stay the only wait.
+//
+
+#ifndef PROJECT_BASE_RINGBUFFER_H
+#define PROJECT_BASE_RINGBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+// binding points of the uniform blocks the shaders declare
+enum UniformBlockBinding {
+    FRAME_BLOCK,    // FrameData: projection, view, viewPosition, far_plane
+    LIGHTS_BLOCK,   // Lights: pointLights[NR_LIGHTS]
+    OBJECT_BLOCK,   // ObjectData: model, one range per draw
+    SHADOW_BLOCK,   // ShadowData: shadowMatrices[6], lightPos, far_plane
+    ATLAS_BLOCK     // ShadowAtlas: shadowSlots[NR_LIGHTS], the secondary lights' cubes (rg::ShadowAtlas)
+};
+
+class RingBuffer {
+public:
+    static const int FRAMES = 3;
+
+    // frames that had to wait for the GPU before their region could be reused
+    unsigned long stalls = 0;
+    // frames that outgrew their region, each grew the ring
+    unsigned long overflows = 0;
+
+    // persistently mapped storage (GL 4.4 / ARB_buffer_storage) when available, otherwise a plain buffer
+    // whose ranges are mapped unsynchronized; the fences make both safe
+    void init(GLsizeiptr bytesPerFrame) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        allocate(bytesPerFrame);
+        frame = FRAMES - 1;
+        head = regionEnd = 0;
+    }
+
+    // the buffer the last map() handed out memory from, the ring or the spare
+    unsigned int buffer() const {
+        return lastBuffer;
+    }
+
+    GLsizeiptr bytesPerFrame() const {
+        return frameBytes;
+    }
+
+    GLint uniformOffsetAlignment() const {
+        return uniformAlignment;
+    }
+
+    bool persistentlyMapped() const {
+        return persistent;
+    }
+
+    // moves to the next region, waiting only if the GPU is still FRAMES frames behind; grows the ring first
+    // if the last frame did not fit
+    void beginFrame() {
+        if (overflowBytes > 0) {
+            GLsizeiptr grown = frameBytes;
+            while (grown < frameBytes + overflowBytes)
+                grown *= 2;
+            // a new buffer: the old one lives on until the GPU is done with it, nothing waits for that
+            release();
+            allocate(grown);
+            overflowBytes = 0;
+            overflows++;
+        }
+        // every range of the spares was bound for draws already submitted; the retired ones are deleted
+        // once those finish, the current one is rewritten through glBufferSubData, which orders itself
+        // after them
+        if (!retired.empty()) {
+            glDeleteBuffers((GLsizei)retired.size(), retired.data());
+            retired.clear();
+        }
+        spareHead = 0;
+        frame = (frame + 1) % FRAMES;
+        wait(fences[frame]);
+        head = frame * frameBytes;
+        regionEnd = head + frameBytes;
+    }
+
+    // fences everything written this frame
+    void endFrame() {
+        if (fences[frame])
+            glDeleteSync(fences[frame]);
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // reserves size bytes of this frame's region, or of the spare once the region is full; write them
+    // through the returned pointer, then unmap() before anything draws from them. The offset is into
+    // buffer()
+    void *map(GLsizeiptr size, GLintptr alignment, GLintptr *offset) {
+        GLintptr start = (head + alignment - 1) / alignment * alignment;
+        if (start + size > regionEnd)
+            return mapSpare(size, alignment, offset);
+        head = start + size;
+        *offset = start;
+        lastBuffer = id;
+        if (persistent)
+            return mapped + start;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        return glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+                                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    }
+
+    void unmap() {
+        if (stagingPending) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, spare);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, stagingOffset, (GLsizeiptr)staging.size(), staging.data());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            stagingPending = false;
+            return;
+        }
+        if (persistent)
+            return;
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // copies data into this frame's region, returns its offset (-1 if it did not fit)
+    GLintptr upload(const void *data, GLsizeiptr size, GLintptr alignment) {
+        GLintptr offset = -1;
+        void *target = map(size, alignment, &offset);
+        if (!target)
+            return -1;
+        std::memcpy(target, data, size);
+        unmap();
+        return offset;
+    }
+
+    // uploads a uniform block and binds it to its binding point
+    void bindUniformBlock(UniformBlockBinding binding, const void *data, GLsizeiptr size) {
+        GLintptr offset = upload(data, size, uniformAlignment);
+        if (offset >= 0)
+            glBindBufferRange(GL_UNIFORM_BUFFER, binding, lastBuffer, offset, size);
+    }
+
+private:
+    unsigned int id = 0;
+    unsigned int lastBuffer = 0;
+    bool persistent = false;
+    unsigned char *mapped = nullptr;
+    GLint uniformAlignment = 256;
+    GLsizeiptr frameBytes = 0;
+    GLsync fences[FRAMES] = {nullptr, nullptr, nullptr};
+    int frame = 0;
+    GLintptr head = 0;
+    GLintptr regionEnd = 0;
+    // what did not fit this frame: bytes the ring grows by, and the spare buffer serving them
+    GLsizeiptr overflowBytes = 0;
+    unsigned int spare = 0;
+    GLsizeiptr spareBytes = 0;
+    GLintptr spareHead = 0;
+    // spares outgrown this frame, deleted at the next
+    std::vector<unsigned int> retired;
+    // the spare is written through glBufferSubData from here on unmap()
+    std::vector<unsigned char> staging;
+    GLintptr stagingOffset = 0;
+    bool stagingPending = false;
+
+    void allocate(GLsizeiptr bytesPerFrame) {
+        frameBytes = bytesPerFrame;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        persistent = glExtensions().bufferStorage;
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glExtensions().BufferStorage(GL_COPY_WRITE_BUFFER, frameBytes * FRAMES, nullptr, flags);
+            mapped = (unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, frameBytes * FRAMES, flags);
+            persistent = mapped != nullptr;
+        }
+        if (!persistent)
+            glBufferData(GL_COPY_WRITE_BUFFER, frameBytes * FRAMES, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        lastBuffer = id;
+    }
+
+    // deleting is deferred by GL until the draws in flight are done, the fences only guarded its regions
+    void release() {
+        if (persistent) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteBuffers(1, &id);
+        for (GLsync &fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    // the rest of an overflowing frame: appended to the spare, a fresh larger spare when that is full too;
+    // the ranges handed out before stay untouched
+    void *mapSpare(GLsizeiptr size, GLintptr alignment, GLintptr *offset) {
+        overflowBytes += size + alignment;
+        GLintptr start = (spareHead + alignment - 1) / alignment * alignment;
+        if (!spare || start + size > spareBytes) {
+            if (spare)
+                retired.push_back(spare);
+            spareBytes = std::max(frameBytes, size);
+            glGenBuffers(1, &spare);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, spare);
+            glBufferData(GL_COPY_WRITE_BUFFER, spareBytes, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            start = 0;
+        }
+        spareHead = start + size;
+        staging.resize(size);
+        stagingOffset = start;
+        stagingPending = true;
+        lastBuffer = spare;
+        *offset = start;
+        return staging.data();
+    }
+
+    void wait(GLsync &fence) {
+        if (!fence)
+            return;
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+};
+
+};
+#endif //PROJECT_BASE_RINGBUFFER_H
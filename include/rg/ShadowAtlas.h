@@ -0,0 +1,281 @@
+//
+// Shadow cubes for the secondary point lights, kept in cube map arrays (GL 4.0 / ARB_texture_cube_map_array).
+// Slots go to the lights that matter most on screen, the most important ones get the high resolution
+// tier. A fixed number of faces is rendered per frame: faces of newly assigned slots first, then the
+// stalest faces weighted by importance, so distant lights refresh round-robin and the cost stays flat
+// however many lights cast shadows.
+//
+
+#ifndef PROJECT_BASE_SHADOWATLAS_H
+#define PROJECT_BASE_SHADOWATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/GLExtensions.h>
+#include <rg/GLState.h>
+#include <rg/GpuCulling.h>
+#include <rg/PointShadowMap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+// a light that wants a shadow this frame
+struct ShadowCaster {
+    glm::vec3 position;
+    float range;        // where its attenuation falls below AttenuationRange's cutoff, also the far plane
+    float intensity;
+};
+
+// distance at which 1 / (constant + linear d + quadratic d^2) drops to cutoff
+inline float AttenuationRange(float constant, float linear, float quadratic, float cutoff = 0.02f) {
+    float target = 1.0f / cutoff - constant;
+    if (target <= 0.0f)
+        return 0.0f;
+    if (quadratic <= 0.0f)
+        return linear > 0.0f ? target / linear : 1.0e3f;
+    return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * target)) / (2.0f * quadratic);
+}
+
+// std140 mirror of one entry of the ShadowAtlas block in 2.model_lighting.fs
+struct ShadowSlotBlock {
+    glm::vec4 position;   // xyz: where the slot was rendered from, w: its far plane
+    GLint tier;           // -1: the light casts no shadow
+    GLint layer;          // cube index in the tier's array
+    GLint padding[2];
+};
+
+class ShadowAtlas {
+public:
+    static const int TIERS = 2;
+    // every slot face is one bit of a 32-bit view mask
+    static const int MAX_SLOTS = 5;
+
+    // faces rendered per frame
+    int faceBudget = 8;
+    // faces rendered in the last update
+    int facesScheduled = 0;
+
+    struct Face {
+        int slot;
+        int face;
+    };
+
+    struct Slot {
+        int tier;
+        int layer;
+        int light = -1;              // index into the casters of update(), -1 while free
+        glm::vec3 position;          // where the faces were rendered from
+        float range = 0.0f;
+        float importance = 0.0f;
+        unsigned int dirty = 0;      // faces that must be rendered before the slot is sampled
+        int age[6] = {0, 0, 0, 0, 0, 0};
+    };
+
+    static bool supported() {
+        return glExtensions().cubeMapArray;
+    }
+
+    // slotsPerTier[t] cubes of resolutions[t]; tier 0 should be the sharpest
+    bool init(const unsigned int resolutions[TIERS], const int slotsPerTier[TIERS]) {
+        if (!supported())
+            return false;
+        slots.clear();
+        for (int tier = 0; tier < TIERS; tier++) {
+            tierResolution[tier] = resolutions[tier];
+            glGenTextures(1, &textures[tier]);
+            glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, textures[tier]);
+            glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT, resolutions[tier], resolutions[tier],
+                         std::max(slotsPerTier[tier], 1) * 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            for (int layer = 0; layer < slotsPerTier[tier] && (int)slots.size() < MAX_SLOTS; layer++) {
+                Slot slot;
+                slot.tier = tier;
+                slot.layer = layer;
+                slots.push_back(slot);
+            }
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ready = true;
+        return true;
+    }
+
+    bool enabled() const {
+        return ready;
+    }
+
+    unsigned int texture(int tier) const {
+        return textures[tier];
+    }
+
+    const std::vector<Slot> &allSlots() const {
+        return slots;
+    }
+
+    // marks the faces of the assigned slots that a sphere (world center, radius) reaches as dirty, for a
+    // shadow caster that moved: called with where it was and where it is before update(), so both are
+    // redrawn ahead of the round-robin
+    void invalidate(const glm::vec4 &sphere) {
+        for (Slot &slot : slots)
+            if (slot.light >= 0)
+                slot.dirty |= PointShadowMap::FaceMask(slot.position, sphere, slot.range);
+    }
+
+    // ranks the casters by what they light on screen, moves slots to the winners and picks the faces to
+    // render this frame (at most faceBudget, see scheduled())
+    void update(const std::vector<ShadowCaster> &casters, const glm::vec3 &cameraPos, const glm::mat4 &viewProjection) {
+        if (!ready)
+            return;
+        glm::vec4 planes[6];
+        ExtractFrustumPlanes(viewProjection, planes);
+
+        // importance: intensity times the screen share of the lit sphere, zero when the sphere is off screen
+        std::vector<std::pair<float, int>> ranked;
+        for (size_t i = 0; i < casters.size(); i++) {
+            const ShadowCaster &caster = casters[i];
+            bool visible = caster.range > 0.0f;
+            for (int plane = 0; plane < 6 && visible; plane++)
+                visible = glm::dot(glm::vec3(planes[plane]), caster.position) + planes[plane].w >= -caster.range;
+            if (!visible)
+                continue;
+            float distance = glm::length(caster.position - cameraPos);
+            float coverage = distance > caster.range ? (caster.range / distance) * (caster.range / distance) : 1.0f;
+            ranked.emplace_back(coverage * caster.intensity, (int)i);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const std::pair<float, int> &a, const std::pair<float, int> &b) {
+            return a.first > b.first;
+        });
+        if (ranked.size() > slots.size())
+            ranked.resize(slots.size());
+
+        // the n most important lights belong in the first n slots (tier order); a light already in a slot
+        // of the right tier keeps it and its rendered faces
+        std::vector<int> wantedTier(casters.size(), -1);
+        std::vector<float> importance(casters.size(), 0.0f);
+        for (size_t rank = 0; rank < ranked.size(); rank++) {
+            wantedTier[ranked[rank].second] = slots[rank].tier;
+            importance[ranked[rank].second] = ranked[rank].first;
+        }
+        for (Slot &slot : slots)
+            if (slot.light >= 0 && (slot.light >= (int)casters.size() || wantedTier[slot.light] != slot.tier))
+                slot.light = -1;
+        for (size_t light = 0; light < casters.size(); light++) {
+            if (wantedTier[light] < 0)
+                continue;
+            Slot *owned = nullptr;
+            for (Slot &slot : slots)
+                if (slot.light == (int)light)
+                    owned = &slot;
+            for (size_t i = 0; i < slots.size() && !owned; i++)
+                if (slots[i].light < 0 && slots[i].tier == wantedTier[light]) {
+                    owned = &slots[i];
+                    owned->light = (int)light;
+                    owned->dirty = 0x3F;
+                }
+            if (!owned)
+                continue;
+            owned->importance = importance[light];
+            // a moved light invalidates everything rendered from its old position
+            if (owned->dirty == 0x3F || glm::length(owned->position - casters[light].position) > 0.01f || owned->range != casters[light].range) {
+                owned->position = casters[light].position;
+                owned->range = casters[light].range;
+                owned->dirty = 0x3F;
+            }
+        }
+
+        // dirty faces first, then the stalest weighted by importance
+        std::vector<std::pair<float, Face>> candidates;
+        for (size_t i = 0; i < slots.size(); i++) {
+            Slot &slot = slots[i];
+            if (slot.light < 0)
+                continue;
+            for (int face = 0; face < 6; face++) {
+                slot.age[face]++;
+                float score = (slot.dirty & (1u << face)) ? 1.0e30f : slot.age[face] * slot.importance;
+                candidates.push_back({score, {(int)i, face}});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, Face> &a, const std::pair<float, Face> &b) {
+            return a.first > b.first;
+        });
+        faces.clear();
+        for (size_t i = 0; i < candidates.size() && (int)faces.size() < faceBudget; i++) {
+            Face face = candidates[i].second;
+            slots[face.slot].age[face.face] = 0;
+            slots[face.slot].dirty &= ~(1u << face.face);
+            faces.push_back(face);
+        }
+        std::sort(faces.begin(), faces.end(), [](const Face &a, const Face &b) {
+            return a.slot != b.slot ? a.slot < b.slot : a.face < b.face;
+        });
+        facesScheduled = (int)faces.size();
+    }
+
+    // faces to render this frame, grouped by slot
+    const std::vector<Face> &scheduled() const {
+        return faces;
+    }
+
+    // the six face view-projections of a slot, in cube face order
+    void faceMatrices(int slot, glm::mat4 matrices[6]) const {
+        const Slot &s = slots[slot];
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, s.range);
+        const glm::vec3 directions[6] = {glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                                         glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+        const glm::vec3 ups[6] = {glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+                                  glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)};
+        for (int face = 0; face < 6; face++)
+            matrices[face] = projection * glm::lookAt(s.position, s.position + directions[face], ups[face]);
+    }
+
+    // binds one face of a slot's cube and clears it
+    void bindFace(int slot, int face) {
+        const Slot &s = slots[slot];
+        GLState &state = glState();
+        state.bindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[s.tier], 0, s.layer * 6 + face);
+        state.viewport(0, 0, tierResolution[s.tier], tierResolution[s.tier]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // per light of update()'s casters: which cube to sample, or tier -1
+    void slotBlocks(ShadowSlotBlock *blocks, int casterCount) const {
+        for (int light = 0; light < casterCount; light++) {
+            blocks[light].position = glm::vec4(0.0f);
+            blocks[light].tier = -1;
+            blocks[light].layer = 0;
+            blocks[light].padding[0] = blocks[light].padding[1] = 0;
+        }
+        for (const Slot &slot : slots) {
+            // a slot is sampled only once all of its faces exist
+            if (slot.light < 0 || slot.light >= casterCount || slot.dirty)
+                continue;
+            blocks[slot.light].position = glm::vec4(slot.position, slot.range);
+            blocks[slot.light].tier = slot.tier;
+            blocks[slot.light].layer = slot.layer;
+        }
+    }
+
+private:
+    bool ready = false;
+    unsigned int textures[TIERS] = {0, 0};
+    unsigned int tierResolution[TIERS] = {0, 0};
+    unsigned int fbo = 0;
+    std::vector<Slot> slots;
+    std::vector<Face> faces;
+};
+
+};
+#endif //PROJECT_BASE_SHADOWATLAS_H
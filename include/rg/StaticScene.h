@@ -0,0 +1,323 @@
+//
+// Static geometry packed into shared vertex/index buffers and drawn with glMultiDrawElementsIndirect.
+// Every mesh is one indirect command drawing all placements of its model; an instance's transform is a
+// per-instance attribute starting at the command's baseInstance, so shaders built with DRAW_INDIRECT read
+// 'model' from location 5 and 'normalMatrix' from location 9. Instances are frustum culled on the GPU per target
+// before they are drawn (rg::GpuCulling). A plain GL 3.3 context has no indirect draws, draws the meshes one
+// by one through the queue and gets no GPU culling.
+//
+
+#ifndef PROJECT_BASE_STATICSCENE_H
+#define PROJECT_BASE_STATICSCENE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/Bounds.h>
+#include <rg/GLExtensions.h>
+#include <rg/GLState.h>
+#include <rg/GpuCulling.h>
+#include <rg/ObjectTransform.h>
+#include <rg/RenderQueue.h>
+
+#include <learnopengl/material.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace rg {
+
+// layout fixed by the GL spec
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// what a set of culled instances is drawn for
+enum CullTarget {
+    CULL_CAMERA,
+    CULL_SHADOW,   // the six faces of the shadow cube
+    CULL_TARGETS
+};
+
+class StaticScene {
+public:
+    // first attribute location of the per-instance model matrix (takes four)
+    static const int MODEL_ATTRIBUTE = 5;
+    // first attribute location of the per-instance normal matrix (takes three)
+    static const int NORMAL_MATRIX_ATTRIBUTE = 9;
+
+    static bool supported() {
+        return glExtensions().multiDrawIndirect;
+    }
+
+    // a model added several times is drawn instanced, one command per mesh
+    void add(Model &model, const glm::mat4 &transform) {
+        objects.push_back({&model, transform});
+    }
+
+    // packs every added model into the shared buffers; false (and nothing is created) without MDI support,
+    // the caller then keeps drawing the meshes one by one
+    bool build() {
+        if (!supported() || objects.empty())
+            return false;
+
+        // commands are ordered so every pass draws a contiguous range per cull state (and material)
+        std::vector<std::pair<Mesh *, Model *>> meshes;
+        for (size_t i = 0; i < objects.size(); i++) {
+            bool firstPlacement = true;
+            for (size_t j = 0; j < i && firstPlacement; j++)
+                firstPlacement = objects[j].model != objects[i].model;
+            if (firstPlacement)
+                for (Mesh &mesh : objects[i].model->meshes)
+                    meshes.emplace_back(&mesh, objects[i].model);
+        }
+        std::stable_sort(meshes.begin(), meshes.end(), [](const std::pair<Mesh *, Model *> &a, const std::pair<Mesh *, Model *> &b) {
+            const Material &ma = a.first->material;
+            const Material &mb = b.first->material;
+            if (ma.blendMode != mb.blendMode)
+                return ma.blendMode < mb.blendMode;
+            if (ma.cullMode != mb.cullMode)
+                return ma.cullMode < mb.cullMode;
+            return &ma < &mb;
+        });
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<glm::mat4> transforms;
+        std::vector<ObjectTransform> objectTransforms;
+        std::vector<glm::vec4> bounds;
+        std::vector<GLuint> instanceCommands;
+        commands.clear();
+        runs.clear();
+        for (const auto &entry : meshes) {
+            Mesh *mesh = entry.first;
+            DrawElementsIndirectCommand command;
+            command.count = (GLuint)mesh->indices.size();
+            command.instanceCount = 0;
+            command.firstIndex = (GLuint)indices.size();
+            command.baseVertex = (GLint)vertices.size();
+            command.baseInstance = (GLuint)transforms.size();
+            vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+            indices.insert(indices.end(), mesh->indices.begin(), mesh->indices.end());
+
+            glm::vec4 sphere = BoundingSphere(*mesh);
+            for (const Object &object : objects) {
+                if (object.model != entry.second)
+                    continue;
+                transforms.push_back(object.transform);
+                bounds.push_back(sphere);
+                instanceCommands.push_back((GLuint)commands.size());
+                command.instanceCount++;
+            }
+
+            Material *material = &mesh->material;
+            if (runs.empty() || runs.back().material != material)
+                runs.push_back({material, (GLsizei)commands.size(), 0});
+            runs.back().count++;
+            commands.push_back(command);
+        }
+        instanceCount = (GLuint)transforms.size();
+        objectTransforms.resize(transforms.size());
+        ComputeObjectTransforms(transforms.data(), objectTransforms.data(), transforms.size());
+
+        GLState &state = glState();
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &transformBuffer);
+        glGenBuffers(1, &boundsBuffer);
+        glGenBuffers(1, &instanceCommandBuffer);
+        glGenBuffers(1, &commandTemplate);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, transformBuffer);
+        glBufferData(GL_ARRAY_BUFFER, objectTransforms.size() * sizeof(ObjectTransform), objectTransforms.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, boundsBuffer);
+        glBufferData(GL_ARRAY_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceCommandBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instanceCommands.size() * sizeof(GLuint), instanceCommands.data(), GL_STATIC_DRAW);
+
+        culling.init();
+        // compaction counts survivors from zero, transform feedback keeps every instance in place
+        std::vector<DrawElementsIndirectCommand> zeroed = commands;
+        if (culling.active() == GpuCulling::CULL_COMPUTE)
+            for (DrawElementsIndirectCommand &command : zeroed)
+                command.instanceCount = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, commandTemplate);
+        glBufferData(GL_ARRAY_BUFFER, zeroed.size() * sizeof(DrawElementsIndirectCommand), zeroed.data(), GL_STATIC_DRAW);
+
+        for (Target &target : targets) {
+            glGenVertexArrays(1, &target.VAO);
+            glGenBuffers(1, &target.commands);
+            glGenBuffers(1, &target.culled);
+            // until the first cull every instance is drawn
+            glBindBuffer(GL_ARRAY_BUFFER, target.commands);
+            glBufferData(GL_ARRAY_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, target.culled);
+            glBufferData(GL_ARRAY_BUFFER, objectTransforms.size() * sizeof(ObjectTransform), objectTransforms.data(), GL_DYNAMIC_COPY);
+
+            state.bindVertexArray(target.VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            if (&target == &targets[0])
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            // same layout as Mesh::setupMesh
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+            // the transforms advance once per instance, and an indirect command's instances start at its
+            // baseInstance, so each instance of a command reads its own entry of the culled transforms
+            glBindBuffer(GL_ARRAY_BUFFER, target.culled);
+            for (int column = 0; column < 4; column++) {
+                glEnableVertexAttribArray(MODEL_ATTRIBUTE + column);
+                glVertexAttribPointer(MODEL_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectTransform),
+                                      (void*)(offsetof(ObjectTransform, model) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(MODEL_ATTRIBUTE + column, 1);
+            }
+            for (int column = 0; column < 3; column++) {
+                glEnableVertexAttribArray(NORMAL_MATRIX_ATTRIBUTE + column);
+                glVertexAttribPointer(NORMAL_MATRIX_ATTRIBUTE + column, 3, GL_FLOAT, GL_FALSE, sizeof(ObjectTransform),
+                                      (void*)(offsetof(ObjectTransform, normal) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(NORMAL_MATRIX_ATTRIBUTE + column, 1);
+            }
+        }
+
+        if (culling.active() == GpuCulling::CULL_TRANSFORM_FEEDBACK) {
+            // frustum_cull.vs reads one instance per vertex: model 0-3, normal matrix columns 4-6, bounds 7
+            glGenVertexArrays(1, &feedbackVAO);
+            state.bindVertexArray(feedbackVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, transformBuffer);
+            for (int column = 0; column < 7; column++) {
+                glEnableVertexAttribArray(column);
+                glVertexAttribPointer(column, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectTransform), (void*)(column * sizeof(glm::vec4)));
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, boundsBuffer);
+            glEnableVertexAttribArray(7);
+            glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        }
+        state.bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        built = true;
+        return true;
+    }
+
+    bool enabled() const {
+        return built;
+    }
+
+    GpuCulling::Method cullingMethod() const {
+        return culling.active();
+    }
+
+    // true for models whose opaque and cutout meshes this scene draws
+    bool contains(const Model *model) const {
+        if (!built)
+            return false;
+        for (const Object &object : objects)
+            if (object.model == model)
+                return true;
+        return false;
+    }
+
+    // refreshes the target's instances against the frusta (one view-projection, or the six cube faces);
+    // everything stays on the GPU, the next draw of the target reads the result
+    void cull(CullTarget target, const glm::mat4 *viewProjections, int frustumCount) {
+        if (!built)
+            return;
+        CullBuffers buffers;
+        buffers.transforms = transformBuffer;
+        buffers.bounds = boundsBuffer;
+        buffers.instanceCommands = instanceCommandBuffer;
+        buffers.feedbackVAO = feedbackVAO;
+        buffers.instanceCount = instanceCount;
+        buffers.commands = targets[target].commands;
+        buffers.commandTemplate = commandTemplate;
+        buffers.commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+        buffers.culled = targets[target].culled;
+        culling.run(buffers, viewProjections, frustumCount);
+    }
+
+    // one glMultiDrawElementsIndirect per run of commands with the same cull state; with bindMaterials,
+    // per material instead, for programs that sample the material textures
+    void draw(CullTarget target, unsigned int program, unsigned int blendModes, bool bindMaterials) {
+        if (!built)
+            return;
+        GLState &state = glState();
+        state.useProgram(program);
+        state.bindVertexArray(targets[target].VAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, targets[target].commands);
+
+        size_t run = 0;
+        while (run < runs.size()) {
+            Material &material = *runs[run].material;
+            if (!(blendModes & BlendMask(material.blendMode))) {
+                run++;
+                continue;
+            }
+            GLsizei first = runs[run].first;
+            GLsizei count = runs[run].count;
+            for (run++; !bindMaterials && run < runs.size(); run++) {
+                const Material &next = *runs[run].material;
+                if (next.cullMode != material.cullMode || !(blendModes & BlendMask(next.blendMode)))
+                    break;
+                count += runs[run].count;
+            }
+            if (bindMaterials)
+                material.bind(program);
+            material.applyCullState();
+            glExtensions().MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                    (const void *)(first * sizeof(DrawElementsIndirectCommand)), count, 0);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+private:
+    struct Object {
+        Model *model;
+        glm::mat4 transform;
+    };
+    // consecutive commands drawing meshes of one material
+    struct Run {
+        Material *material;
+        GLsizei first;
+        GLsizei count;
+    };
+
+    // VAO reading the target's culled transforms, and its commands
+    struct Target {
+        unsigned int VAO = 0;
+        unsigned int commands = 0;
+        unsigned int culled = 0;
+    };
+
+    std::vector<Object> objects;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<Run> runs;
+    bool built = false;
+    unsigned int VBO = 0, EBO = 0;
+    // per instance: source transform (model and normal matrix), local bounding sphere, command it belongs to
+    unsigned int transformBuffer = 0;
+    unsigned int boundsBuffer = 0;
+    unsigned int instanceCommandBuffer = 0;
+    GLuint instanceCount = 0;
+    unsigned int commandTemplate = 0;
+    unsigned int feedbackVAO = 0;
+    Target targets[CULL_TARGETS];
+    GpuCulling culling;
+};
+
+};
+#endif //PROJECT_BASE_STATICSCENE_H
@@ -0,0 +1,129 @@
+//
+// Temporal anti-aliasing that doubles as the upscaler. The camera passes render below the screen size with
+// the projection shifted by a different sub-pixel offset every frame; the resolve reconstructs each screen
+// pixel from the nearby rendered samples, adds it to the previous resolved frame fetched along the
+// velocity buffer, and clamps that history to the current neighborhood so disoccluded or changed pixels
+// don't smear. Over the jitter sequence every screen pixel gets covered, so a frame rendered with half the
+// pixels resolves close to a native one.
+//
+
+#ifndef PROJECT_BASE_TEMPORALAA_H
+#define PROJECT_BASE_TEMPORALAA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Fullscreen.h>
+#include <rg/GLState.h>
+#include <rg/RenderTargetPool.h>
+
+namespace rg {
+
+class TemporalAA {
+public:
+    // length of the jitter sequence, the history holds about as many frames at the default blend
+    static const int JITTER_PHASES = 8;
+
+    bool enabled = false;
+    // per-axis fraction of the screen the camera passes render, 0.71 is about half the pixels
+    float renderScale = 0.71f;
+    // weight of the new frame where one of its samples lands on the pixel, lower is smoother but ghosts more
+    float blend = 0.1f;
+
+    // called once per frame after the pool's: holds the two screen-sized history targets while enabled,
+    // and drops them, and with them the history, when disabled or resized
+    void beginFrame(RenderTargetPool &pool) {
+        RenderTargetDesc desc = pool.screen(GL_RGBA16F, TARGET_FILTERED);
+        if (history[0] && (!enabled || !(desc == historyDesc))) {
+            pool.release(history[0]);
+            pool.release(history[1]);
+            history[0] = history[1] = 0;
+        }
+        if (enabled && !history[0]) {
+            historyDesc = desc;
+            history[0] = pool.acquire(desc);
+            history[1] = pool.acquire(desc);
+            valid = false;
+        }
+        phase = (phase + 1) % JITTER_PHASES;
+    }
+
+    // the next resolve starts over from the current frame, for cuts and teleports of the camera
+    void invalidate() {
+        valid = false;
+    }
+
+    // this frame's sample offset in rendered pixels, within half a pixel of the center; Halton (2, 3) covers
+    // the pixel evenly at any length of the sequence
+    glm::vec2 jitter() const {
+        if (!enabled)
+            return glm::vec2(0.0f);
+        return glm::vec2(Halton(phase + 1, 2), Halton(phase + 1, 3)) - 0.5f;
+    }
+
+    // projection shifted by jitter pixels of a width x height viewport
+    static glm::mat4 Jitter(const glm::mat4 &projection, const glm::vec2 &jitter, int width, int height) {
+        glm::vec3 offset(2.0f * jitter.x / (float)width, 2.0f * jitter.y / (float)height, 0.0f);
+        return glm::translate(glm::mat4(1.0f), offset) * projection;
+    }
+
+    static float Halton(int index, int base) {
+        float result = 0.0f;
+        float fraction = 1.0f;
+        while (index > 0) {
+            fraction /= (float)base;
+            result += fraction * (float)(index % base);
+            index /= base;
+        }
+        return result;
+    }
+
+    // resolves the bottom left renderWidth x renderHeight of color (with its depth and velocity, all the
+    // size of the pool's screen) into the next history target; viewProjection and previousViewProjection
+    // are unjittered, they reproject the pixels no geometry wrote velocity for. Binds textures from unit on
+    void resolve(RenderTargetPool &pool, Shader &shader, unsigned int color, unsigned int depth, unsigned int velocity,
+                 int renderWidth, int renderHeight, const glm::mat4 &viewProjection,
+                 const glm::mat4 &previousViewProjection, unsigned int unit) {
+        GLState &state = glState();
+        int next = 1 - current;
+        state.bindFramebuffer(GL_FRAMEBUFFER, pool.framebuffer(history[next]));
+        state.viewport(0, 0, historyDesc.width, historyDesc.height);
+        state.setEnabled(GL_DEPTH_TEST, false);
+        shader.use();
+        shader.setInt("scene", unit);
+        shader.setInt("sceneDepth", unit + 1);
+        shader.setInt("velocity", unit + 2);
+        shader.setInt("history", unit + 3);
+        shader.setVec2("renderSize", glm::vec2(renderWidth, renderHeight));
+        shader.setVec2("outputSize", glm::vec2(historyDesc.width, historyDesc.height));
+        shader.setVec2("jitter", jitter());
+        shader.setFloat("blend", blend);
+        shader.setInt("historyValid", valid);
+        shader.setMat4("reprojection", previousViewProjection * glm::inverse(viewProjection));
+        state.bindTexture(unit, GL_TEXTURE_2D, color);
+        state.bindTexture(unit + 1, GL_TEXTURE_2D, depth);
+        state.bindTexture(unit + 2, GL_TEXTURE_2D, velocity);
+        state.bindTexture(unit + 3, GL_TEXTURE_2D, history[current]);
+        DrawFullscreenTriangle();
+        state.setEnabled(GL_DEPTH_TEST, true);
+        current = next;
+        valid = true;
+    }
+
+    // the last resolved frame, screen-sized linear HDR; 0 while disabled
+    unsigned int output() const {
+        return history[current];
+    }
+
+private:
+    unsigned int history[2] = {0, 0};
+    RenderTargetDesc historyDesc = {0, 0, GL_NONE, 0};
+    // history[current] holds the last resolve
+    int current = 0;
+    bool valid = false;
+    int phase = 0;
+};
+
+};
+#endif //PROJECT_BASE_TEMPORALAA_H
@@ -30,6 +30,13 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data);
 
+// Optional: per-frame streaming allocator for vertex/index data, instead of glBufferData() per draw list.
+// 'alloc' returns a CPU pointer to 'size' writable bytes of GL buffer '*buffer' at '*offset' (aligned to 'alignment'),
+// or NULL to fall back to glBufferData(); 'commit' is called once the bytes are written, before they are drawn.
+typedef void*   (*ImGui_ImplOpenGL3_StreamAlloc)(size_t size, size_t alignment, unsigned int* buffer, size_t* offset, void* user_data);
+typedef void    (*ImGui_ImplOpenGL3_StreamCommit)(void* user_data);
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_SetStreamAllocator(ImGui_ImplOpenGL3_StreamAlloc alloc, ImGui_ImplOpenGL3_StreamCommit commit, void* user_data);
+
 // (Optional) Called by Init/NewFrame/Shutdown
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateFontsTexture();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
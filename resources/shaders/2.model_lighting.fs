@@ -1,12 +1,23 @@
 #version 330 core
+#pragma features BLINN SHADOWS SHADOW_ATLAS SHADOW_COMPARE SHADOW_MOMENTS SHADOW_PARABOLOID SHADOW_MASK SCREEN_SHADOW
+#ifdef SHADOW_ATLAS
+#extension GL_ARB_texture_cube_map_array : enable
+#endif
+#ifdef SCREEN_SHADOW
+// with fullscreen.vs, the half resolution shadow mask pass: r is pointLights[0]'s shadow, g the linear depth
+// it was evaluated at
+layout (location = 0) out vec2 ShadowMask;
+
+in vec2 TexCoords;
+#else
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
 } fs_in;
+#endif
 
 float near = 0.1;
 float far = 100.0;
@@ -15,16 +26,15 @@ float LinearizeDepth(float depth) {
     return (2.0 * near * far) / (far + near - z * (far - near));
 }
 
+// std140: every vec3 shares its 16 bytes with the float after it
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct Material {
@@ -42,20 +52,130 @@ vec3 gridSamplingDisk[20] = vec3[]
    vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
    vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
 );
+#ifdef SHADOW_COMPARE
+// compare sampler (rg::PointShadowMap::compareSampler), linear filtering blends four texel compares per tap
+uniform samplerCubeShadow depthMap;
+// taps of the quality tier (rg::ShadowQuality) for a fragment next to the camera, fewer further away
+uniform int shadowSamples;
+// spread over the kernel, they decide whether the remaining taps are needed
+const int probeTaps[4] = int[](0, 2, 5, 7);
+#else
 uniform samplerCube depthMap;
-uniform float far_plane;
-uniform bool shadows;
+#endif
+#ifdef SHADOW_PARABOLOID
+// light 0's two hemispheres instead of the cube (rg::ParaboloidShadowMap), compared in hardware
+uniform sampler2DArrayShadow paraboloidMap;
+#endif
+#ifdef SHADOW_MOMENTS
+// prefiltered (depth, depth^2) of light 0 (rg::MomentShadowMap)
+uniform samplerCube momentMap;
+uniform float minVariance;
+uniform float bleedReduction;
+#endif
 
-uniform int NR_LIGHTS;
-uniform PointLight pointLights[5];
+// injected by Shader::define, the light loop below unrolls to a constant
+#ifndef NR_LIGHTS
+#define NR_LIGHTS 5
+#endif
+// streamed through the ring buffer (rg::LIGHTS_BLOCK)
+layout (std140) uniform Lights {
+    PointLight pointLights[NR_LIGHTS];
+};
+// per-frame data, streamed through the ring buffer (rg::FRAME_BLOCK)
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+    float far_plane;
+};
+// the point shadow is rendered from its own, cached light position (rg::SHADOW_BLOCK)
+layout (std140) uniform ShadowData {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+} shadow;
+#ifdef SHADOW_ATLAS
+// the secondary lights' cubes (rg::ShadowAtlas, rg::ATLAS_BLOCK), one entry per light
+struct ShadowSlot {
+    vec4 position;   // xyz: where the cube was rendered from, w: its far plane
+    ivec4 info;      // x: resolution tier (-1: no shadow), y: cube index in the tier's array
+};
+layout (std140) uniform ShadowAtlas {
+    ShadowSlot shadowSlots[NR_LIGHTS];
+};
+uniform samplerCubeArray shadowAtlasHigh;
+uniform samplerCubeArray shadowAtlasLow;
+#endif
 uniform Material material;
-uniform bool shouldDiscard;
-uniform vec3 viewPosition;
-uniform bool blinn;
 
+#ifdef SHADOW_COMPARE
 float ShadowCalculation(vec3 fragPos)
 {
-    vec3 fragToLight = fragPos - pointLights[0].position;
+    vec3 fragToLight = fragPos - shadow.lightPos;
+    float bias = 0.15;
+    // the cube stores distance / far_plane, a tap returns 1 where the fragment is not behind it
+    float reference = (length(fragToLight) - bias) / shadow.far_plane;
+    if(shadowSamples <= 1)
+        return 1.0 - texture(depthMap, vec4(fragToLight, reference));
+    float viewDistance = length(viewPosition - fragPos);
+    float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
+    int samples = max(4, int(float(shadowSamples) * clamp(1.0 - viewDistance / (2.0 * far_plane), 0.0, 1.0)));
+    float lit = 0.0;
+    for(int i = 0; i < 4; ++i)
+        lit += texture(depthMap, vec4(fragToLight + gridSamplingDisk[probeTaps[i]] * diskRadius, reference));
+    // the probes agree: away from a penumbra the full kernel gives the same answer
+    if(lit == 0.0 || lit == 4.0 || samples <= 4)
+        return 1.0 - lit / 4.0;
+    int taken = 4;
+    for(int i = 0; i < 20 && taken < samples; ++i)
+    {
+        if(i == probeTaps[0] || i == probeTaps[1] || i == probeTaps[2] || i == probeTaps[3])
+            continue;
+        lit += texture(depthMap, vec4(fragToLight + gridSamplingDisk[i] * diskRadius, reference));
+        ++taken;
+    }
+    return 1.0 - lit / float(taken);
+}
+#elif defined(SHADOW_PARABOLOID)
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - shadow.lightPos;
+    float currentDepth = length(fragToLight);
+    float reference = (currentDepth - 0.15) / shadow.far_plane;
+    // same hemisphere mapping as the PARABOLOID variant of point_shadows.vs
+    vec3 d = fragToLight / max(currentDepth, 0.0001);
+    float layer = d.y <= 0.0 ? 0.0 : 1.0;
+    vec3 p = layer == 0.0 ? vec3(-d.x, d.z, -d.y) : vec3(-d.x, -d.z, d.y);
+    vec2 st = p.xy / (1.0 + p.z) * 0.5 + 0.5;
+    // four bilinear compares, a 3x3 texel footprint
+    vec2 texel = 1.0 / vec2(textureSize(paraboloidMap, 0).xy);
+    float lit = 0.0;
+    for(int i = 0; i < 4; ++i)
+    {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+        lit += texture(paraboloidMap, vec4(st + offset, layer, reference));
+    }
+    return 1.0 - lit / 4.0;
+}
+#elif defined(SHADOW_MOMENTS)
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - shadow.lightPos;
+    float depth = length(fragToLight) / shadow.far_plane;
+    vec2 moments = texture(momentMap, fragToLight).rg;
+    if(depth <= moments.x)
+        return 0.0;
+    // Chebyshev's upper bound on the lit fraction, its low tail cut off where casters overlap
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = depth - moments.x;
+    float lit = variance / (variance + d * d);
+    lit = clamp((lit - bleedReduction) / (1.0 - bleedReduction), 0.0, 1.0);
+    return 1.0 - lit;
+}
+#else
+float ShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - shadow.lightPos;
     float currentDepth = length(fragToLight);
     float shadow = 0.0;
     float bias = 0.15;
@@ -72,6 +192,101 @@ float ShadowCalculation(vec3 fragPos)
     shadow /= float(samples);
     return shadow;
 }
+#endif
+
+#ifdef SCREEN_SHADOW
+// the pre-pass depth at full resolution, and the inverse of the (jittered) camera that rendered it
+uniform sampler2D sceneDepth;
+uniform mat4 inverseViewProjection;
+uniform vec2 renderSize;
+
+void main()
+{
+    // one of the 2x2 depths under the texel, in a checkerboard the nearest or the farthest, so on a
+    // foliage edge both the leaf and what is behind it get samples the lighting pass can pick from
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    bool nearest = ((base.x + base.y) & 2) == 0;
+    ivec2 chosen = base;
+    float depth = texelFetch(sceneDepth, base, 0).r;
+    for(int i = 1; i < 4; ++i)
+    {
+        ivec2 texel = base + ivec2(i & 1, i >> 1);
+        float d = texelFetch(sceneDepth, texel, 0).r;
+        if(nearest ? d < depth : d > depth)
+        {
+            depth = d;
+            chosen = texel;
+        }
+    }
+    // the sky is never shadowed
+    if(depth >= 1.0)
+    {
+        ShadowMask = vec2(0.0, far);
+        return;
+    }
+    vec4 position = inverseViewProjection * vec4((vec2(chosen) + 0.5) / renderSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    ShadowMask = vec2(ShadowCalculation(position.xyz / position.w), LinearizeDepth(depth));
+}
+#else
+
+#ifdef SHADOW_MASK
+// pointLights[0]'s shadow from the half resolution mask, bilaterally upsampled: of the four mask texels
+// around the pixel only those evaluated on the same surface count. A pixel none of them matches (a thin
+// leaf, a blended mesh) evaluates the shadow itself rather than borrow it across the edge
+uniform sampler2D shadowMask;
+// mask texels the SCREEN_SHADOW pass wrote, half the rendered size
+uniform vec2 shadowMaskSize;
+
+float MaskedShadow(vec3 fragPos)
+{
+    float depth = LinearizeDepth(gl_FragCoord.z);
+    // a surface's own depth changes across a mask texel, more so at grazing angles
+    float tolerance = depth * 0.01 + 2.0 * fwidth(depth);
+    vec2 position = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    float shadow = 0.0;
+    float weightSum = 0.0;
+    for(int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), ivec2(shadowMaskSize) - 1);
+        vec2 mask = texelFetch(shadowMask, texel, 0).rg;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y * clamp(1.0 - abs(mask.g - depth) / tolerance, 0.0, 1.0);
+        shadow += mask.r * weight;
+        weightSum += weight;
+    }
+    if(weightSum < 0.001)
+        return ShadowCalculation(fragPos);
+    return shadow / weightSum;
+}
+#endif
+
+#ifdef SHADOW_ATLAS
+// a small fixed kernel, these lights are dimmer and further away than pointLights[0]
+float AtlasShadowCalculation(int light, vec3 fragPos)
+{
+    ShadowSlot slot = shadowSlots[light];
+    if(slot.info.x < 0)
+        return 0.0;
+    vec3 fragToLight = fragPos - slot.position.xyz;
+    float currentDepth = length(fragToLight);
+    if(currentDepth >= slot.position.w)
+        return 0.0;
+    float bias = 0.15;
+    float diskRadius = currentDepth / 50.0;
+    float shadow = 0.0;
+    for(int i = 0; i < 4; ++i)
+    {
+        vec4 coord = vec4(fragToLight + gridSamplingDisk[i] * diskRadius, float(slot.info.y));
+        float closestDepth = slot.info.x == 0 ? texture(shadowAtlasHigh, coord).r : texture(shadowAtlasLow, coord).r;
+        if(currentDepth - bias > closestDepth * slot.position.w)
+            shadow += 1.0;
+    }
+    return shadow / 4.0;
+}
+#endif
 
 void main()
 {
@@ -79,27 +294,33 @@ void main()
     // color
     vec4 color = texture(material.texture_diffuse1, fs_in.TexCoords);
     // calculate shadow
-    float shadow = shadows ? ShadowCalculation(fs_in.FragPos) : 0.0;
+#if defined(SHADOWS) && defined(SHADOW_MASK)
+    float shadow = MaskedShadow(fs_in.FragPos);
+#elif defined(SHADOWS)
+    float shadow = ShadowCalculation(fs_in.FragPos);
+#else
+    float shadow = 0.0;
+#endif
     // depth
     float depth = LinearizeDepth(gl_FragCoord.z) / far;
+    vec3 normal = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(viewPosition - fs_in.FragPos);
     for(int i=0; i<NR_LIGHTS; i++) {
         //ambient
         vec3 ambient = pointLights[i].ambient * color.rgb;
         // diffuse
-        vec3 normal = normalize(fs_in.Normal);
         vec3 lightDir = normalize(pointLights[i].position - fs_in.FragPos);
         float diff = max(dot(lightDir, normal), 0.0);
         vec3 diffuse = diff * color.rgb;
         //specular
-        vec3 viewDir = normalize(viewPosition - fs_in.FragPos);
-        vec3 reflectDir = reflect(-lightDir, normal);
-        float spec = 0.0;
         //blinn set and check
+#ifdef BLINN
         vec3 halfwayDir = normalize(lightDir + viewDir);
-        if(blinn)
-            spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-        else
-            spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+#else
+        vec3 reflectDir = reflect(-lightDir, normal);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
 
         vec3 specular = vec3(0.3) * spec;
         //attenuation
@@ -112,18 +333,15 @@ void main()
         if(i == 0)
             lighting += ambient + (1.0 - shadow) * (diffuse + specular);
         else
+#ifdef SHADOW_ATLAS
+            lighting += 1.5 * ambient + (1.0 - AtlasShadowCalculation(i, fs_in.FragPos)) * (diffuse + specular);
+#else
             lighting += 1.5 * ambient + (diffuse + specular);
+#endif
     }
 
-    // check whether result is higher than some threshold, if so, output as bloom threshold color
-    float brightness = dot(lighting, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0)
-        BrightColor = vec4(lighting, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-
-    if(color.a < 0.1 || shouldDiscard)
-        discard;
+    // the bright pass happens in the first bloom downsample (bloom_downsample.fs), not here
     // to get a weird effect, put depth before the closing bracket on the left
-    FragColor = vec4(lighting + depth, 1.0);
-}
\ No newline at end of file
+    FragColor = vec4(lighting + depth, color.a);
+}
+#endif
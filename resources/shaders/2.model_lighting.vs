@@ -1,4 +1,5 @@
 #version 330 core
+#pragma features REVERSE_NORMALS DRAW_INDIRECT
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
@@ -9,19 +10,36 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#ifdef DRAW_INDIRECT
+// rg::StaticScene instance transform
+layout (location = 5) in mat4 model;
+layout (location = 9) in mat3 normalMatrix;
+#else
+// per-draw data, one ring buffer range per draw (rg::OBJECT_BLOCK)
+layout (std140) uniform ObjectData {
+    mat4 model;
+    mat3 normalMatrix;   // transpose(inverse(mat3(model))), computed on the CPU (rg::ObjectTransform)
+};
+#endif
+// per-frame data, streamed through the ring buffer (rg::FRAME_BLOCK)
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+    float far_plane;
+};
 
-uniform bool reverse_normals;
+// depth is laid down by depth_prepass*.vs and tested with GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    if(reverse_normals)
-        vs_out.Normal = transpose(inverse(mat3(model))) * (-1.0 * aNormal);
-    else
-        vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
+#ifdef REVERSE_NORMALS
+    vs_out.Normal = normalMatrix * (-1.0 * aNormal);
+#else
+    vs_out.Normal = normalMatrix * aNormal;
+#endif
     vs_out.TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#version 330 core
+#pragma features BRIGHT_PASS
+// one step down the bloom chain (rg::BloomChain): 13 bilinear taps, four overlapping 2x2 boxes around the
+// center and one on it, weighted so the result doesn't shimmer as bright pixels move across texels
+layout (location = 0) out vec3 Downsample;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// of the source, the target is half its size
+uniform vec2 texelSize;
+// the part of the source to read, the first step only reads what the scene rendered at its dynamic
+// resolution (rg::DynamicResolution); uvMax keeps the taps half a texel inside it
+uniform vec2 uvScale;
+uniform vec2 uvMax;
+
+vec3 tap(vec2 offset)
+{
+    return texture(source, min(TexCoords * uvScale + offset, uvMax)).rgb;
+}
+
+#ifdef BRIGHT_PASS
+// the first step reads the HDR scene itself: keep what is brighter than threshold, with a soft knee
+// below it, and weight each box by 1 / (1 + luma) so a few very bright texels can't make it flicker
+uniform float threshold;
+uniform float knee;
+
+vec4 brightBox(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    vec3 color = (a + b + c + d) * 0.25;
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.00001);
+    color *= max(soft, brightness - threshold) / max(brightness, 0.00001);
+    float weight = 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    return vec4(color * weight, weight);
+}
+#endif
+
+void main()
+{
+    float x = texelSize.x;
+    float y = texelSize.y;
+
+    vec3 a = tap(vec2(-2.0 * x,  2.0 * y));
+    vec3 b = tap(vec2( 0.0,      2.0 * y));
+    vec3 c = tap(vec2( 2.0 * x,  2.0 * y));
+    vec3 d = tap(vec2(-2.0 * x,  0.0));
+    vec3 e = tap(vec2(0.0));
+    vec3 f = tap(vec2( 2.0 * x,  0.0));
+    vec3 g = tap(vec2(-2.0 * x, -2.0 * y));
+    vec3 h = tap(vec2( 0.0,     -2.0 * y));
+    vec3 i = tap(vec2( 2.0 * x, -2.0 * y));
+    vec3 j = tap(vec2(-x,  y));
+    vec3 k = tap(vec2( x,  y));
+    vec3 l = tap(vec2(-x, -y));
+    vec3 m = tap(vec2( x, -y));
+
+    // the center box counts half, the four corner boxes an eighth each
+#ifdef BRIGHT_PASS
+    vec4 boxes = brightBox(j, k, l, m) * 0.5;
+    boxes += (brightBox(a, b, d, e) + brightBox(b, c, e, f) + brightBox(d, e, g, h) + brightBox(e, f, h, i)) * 0.125;
+    Downsample = boxes.rgb / max(boxes.a, 0.00001);
+#else
+    Downsample = e * 0.125;
+    Downsample += (a + c + g + i) * 0.03125;
+    Downsample += (b + d + f + h) * 0.0625;
+    Downsample += (j + k + l + m) * 0.125;
+#endif
+}
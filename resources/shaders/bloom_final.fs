@@ -1,23 +1,37 @@
 #version 330 core
+// the whole post chain in one fullscreen triangle: bloom composite, tone mapping, grading, gamma
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
 uniform sampler2D scene;
+// the part of scene the camera passes rendered at the dynamic resolution, stretched over the screen by
+// the bilinear fetch; sceneMax keeps it half a texel inside
+uniform vec2 sceneScale;
+uniform vec2 sceneMax;
+// the first level of rg::BloomChain, half resolution
 uniform sampler2D bloomBlur;
 uniform bool bloom;
+uniform float bloomStrength;
 uniform float exposure;
+// grading after tone mapping, 1 leaves the image as it is
+uniform float saturation;
+uniform float contrast;
+uniform vec3 tint;
 
 void main()
 {
     const float gamma = 2.2;
-    vec3 hdrColor = texture(scene, TexCoords).rgb;
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+    vec3 hdrColor = texture(scene, min(TexCoords * sceneScale, sceneMax)).rgb;
     if(bloom)
-        hdrColor += bloomColor; // additive blending
+        hdrColor += texture(bloomBlur, TexCoords).rgb * bloomStrength; // additive blending
     // tone mapping
     vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+    // color grading
+    float luma = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    result = mix(vec3(luma), result, saturation);
+    result = clamp((result - 0.5) * contrast + 0.5, 0.0, 1.0) * tint;
     // also gamma correct while we're at it
     result = pow(result, vec3(1.0 / gamma));
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,32 @@
+#version 330 core
+// one step up the bloom chain (rg::BloomChain): a 3x3 tent over the smaller mip, blended additively onto
+// the larger one, which still holds its own downsample
+layout (location = 0) out vec3 Upsample;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// tent radius in UV units
+uniform vec2 filterRadius;
+
+void main()
+{
+    float x = filterRadius.x;
+    float y = filterRadius.y;
+
+    vec3 a = texture(source, TexCoords + vec2(-x,  y)).rgb;
+    vec3 b = texture(source, TexCoords + vec2( 0,  y)).rgb;
+    vec3 c = texture(source, TexCoords + vec2( x,  y)).rgb;
+    vec3 d = texture(source, TexCoords + vec2(-x,  0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + vec2( x,  0)).rgb;
+    vec3 g = texture(source, TexCoords + vec2(-x, -y)).rgb;
+    vec3 h = texture(source, TexCoords + vec2( 0, -y)).rgb;
+    vec3 i = texture(source, TexCoords + vec2( x, -y)).rgb;
+
+    // 1 2 1 / 2 4 2 / 1 2 1
+    Upsample = e * 4.0;
+    Upsample += (b + d + f + h) * 2.0;
+    Upsample += (a + c + g + i);
+    Upsample *= 1.0 / 16.0;
+}
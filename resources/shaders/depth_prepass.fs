@@ -0,0 +1,16 @@
+#version 330 core
+#ifdef VELOCITY
+// screen-space motion since the last frame, in texture coordinates (rg::TemporalAA)
+layout (location = 0) out vec2 Velocity;
+
+in vec4 currentClip;
+in vec4 previousClip;
+#endif
+
+void main()
+{
+    // depth only, unless the velocity variant writes the motion
+#ifdef VELOCITY
+    Velocity = (currentClip.xy / currentClip.w - previousClip.xy / previousClip.w) * 0.5;
+#endif
+}
@@ -0,0 +1,25 @@
+#version 330 core
+in vec2 TexCoords;
+#ifdef VELOCITY
+// screen-space motion since the last frame, in texture coordinates (rg::TemporalAA)
+layout (location = 0) out vec2 Velocity;
+
+in vec4 currentClip;
+in vec4 previousClip;
+#endif
+
+struct Material {
+    sampler2D texture_diffuse1;
+};
+
+uniform Material material;
+
+void main()
+{
+    // alpha test only, so foliage holes are punched before any lighting runs
+    if(texture(material.texture_diffuse1, TexCoords).a < 0.1)
+        discard;
+#ifdef VELOCITY
+    Velocity = (currentClip.xy / currentClip.w - previousClip.xy / previousClip.w) * 0.5;
+#endif
+}
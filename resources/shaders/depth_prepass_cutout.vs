@@ -0,0 +1,54 @@
+#version 330 core
+#pragma features DRAW_INDIRECT VELOCITY
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+#ifdef DRAW_INDIRECT
+// rg::StaticScene instance transform
+layout (location = 5) in mat4 model;
+#else
+// per-draw data, one ring buffer range per draw (rg::OBJECT_BLOCK)
+layout (std140) uniform ObjectData {
+    mat4 model;
+    mat3 normalMatrix;   // unused here, same block as 2.model_lighting.vs
+    uint viewMask;       // unused here, same block as point_shadows.vs
+    mat4 previousModel;  // where the object was last frame, for the velocity
+};
+#endif
+// per-frame data, streamed through the ring buffer (rg::FRAME_BLOCK)
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+    float far_plane;
+    // the camera without the TAA jitter (rg::TemporalAA), this frame and last; the velocity is the motion of
+    // the surface, not of the sample pattern
+    mat4 viewProjection;
+    mat4 previousViewProjection;
+};
+
+#ifdef VELOCITY
+out vec4 currentClip;
+out vec4 previousClip;
+#endif
+
+// must match 2.model_lighting.vs bit for bit, the color pass runs with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+#ifdef VELOCITY
+    currentClip = viewProjection * vec4(fragPos, 1.0);
+#ifdef DRAW_INDIRECT
+    // the multi-draws are the static scene, it never moves
+    previousClip = previousViewProjection * vec4(fragPos, 1.0);
+#else
+    previousClip = previousViewProjection * previousModel * vec4(aPos, 1.0);
+#endif
+#endif
+}
@@ -0,0 +1,40 @@
+#version 330 core
+layout (location = 0) in mat4 aModel;
+layout (location = 4) in mat3x4 aNormalMatrix;   // mat3 columns padded to vec4, as in rg::ObjectTransform
+layout (location = 7) in vec4 aBounds;   // local sphere: center, radius
+
+// transform feedback fallback of frustum_cull.comp: without atomics the instances cannot be compacted,
+// a culled one is written as a zero matrix instead, its triangles collapse to a point and never rasterize
+out mat4 culledModel;
+out mat3x4 culledNormalMatrix;   // captured as twelve floats, the padded mat3 the draws read
+
+// an instance survives if it is inside any of the frusta; no frusta, no culling
+uniform int frustumCount;
+uniform vec4 planes[36];
+
+bool visible(vec3 center, float radius)
+{
+    if(frustumCount == 0)
+        return true;
+    for(int frustum = 0; frustum < frustumCount; ++frustum)
+    {
+        bool inside = true;
+        for(int plane = 0; plane < 6 && inside; ++plane)
+        {
+            vec4 p = planes[frustum * 6 + plane];
+            inside = dot(p.xyz, center) + p.w >= -radius;
+        }
+        if(inside)
+            return true;
+    }
+    return false;
+}
+
+void main()
+{
+    vec3 center = vec3(aModel * vec4(aBounds.xyz, 1.0));
+    float scale = max(length(aModel[0].xyz), max(length(aModel[1].xyz), length(aModel[2].xyz)));
+    bool survives = visible(center, aBounds.w * scale);
+    culledModel = survives ? aModel : mat4(0.0);
+    culledNormalMatrix = survives ? aNormalMatrix : mat3x4(0.0);
+}
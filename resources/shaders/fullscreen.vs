@@ -0,0 +1,10 @@
+#version 330 core
+// one triangle over the whole viewport, no vertex buffer needed (rg::DrawFullscreenTriangle)
+out vec2 TexCoords;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    TexCoords = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -1,8 +1,12 @@
 #version 330 core
 in vec4 FragPos;
 
-uniform vec3 lightPos;
-uniform float far_plane;
+// streamed through the ring buffer (rg::SHADOW_BLOCK)
+layout (std140) uniform ShadowData {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+};
 
 void main()
 {
@@ -2,7 +2,12 @@
 layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
-uniform mat4 shadowMatrices[6];
+// streamed through the ring buffer (rg::SHADOW_BLOCK)
+layout (std140) uniform ShadowData {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+};
 
 out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
@@ -1,9 +1,81 @@
 #version 330 core
+#pragma features DRAW_INDIRECT SHADOW_FACE VERTEX_LAYER PARABOLOID
+#ifdef VERTEX_LAYER
+// either one lets the vertex shader pick the layer
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
+#ifdef DRAW_INDIRECT
+// rg::StaticScene instance transform
+layout (location = 5) in mat4 model;
+#else
+// per-draw data, one ring buffer range per draw (rg::OBJECT_BLOCK)
+layout (std140) uniform ObjectData {
+    mat4 model;
+    mat3 normalMatrix;   // unused here, same block as 2.model_lighting.vs
+    uint viewMask;       // cube faces the object reaches, one instance each with VERTEX_LAYER
+};
+#endif
+
+#if defined(SHADOW_FACE) || defined(VERTEX_LAYER) || defined(PARABOLOID)
+// without point_shadows.gs the vertex shader projects into the face itself
+layout (std140) uniform ShadowData {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+};
+out vec4 FragPos;
+#endif
+#ifdef SHADOW_FACE
+uniform int shadowFace;
+#endif
+#ifdef PARABOLOID
+// 0: the hemisphere below the light, 1: above (rg::ParaboloidShadowMap)
+uniform int hemisphere;
+#endif
+
+#ifdef VERTEX_LAYER
+// the n-th face set in the mask
+int maskedFace(uint mask, int n)
+{
+    for(int face = 0; face < 6; ++face)
+    {
+        if((mask & (1u << uint(face))) != 0u)
+        {
+            if(n == 0)
+                return face;
+            --n;
+        }
+    }
+    return 0;
+}
+#endif
 
 void main()
 {
+#if defined(PARABOLOID)
+    FragPos = model * vec4(aPos, 1.0);
+    vec3 d = FragPos.xyz - lightPos;
+    float lightDistance = length(d);
+    // the hemisphere's axis becomes z; 2.model_lighting.fs looks up with the same mapping. Looking down +z,
+    // x is negated so the projection isn't mirrored and front faces keep their winding for the cull state
+    vec3 p = hemisphere == 0 ? vec3(-d.x, d.z, -d.y) : vec3(-d.x, -d.z, d.y);
+    p /= max(lightDistance, 0.0001);
+    // the paraboloid maps the whole hemisphere onto the unit disk; the back half is clipped, the
+    // fragment shader writes the exact distance
+    gl_Position = vec4(p.xy / (1.0 + p.z), lightDistance / far_plane * 2.0 - 1.0, 1.0);
+    gl_ClipDistance[0] = p.z;
+#elif defined(SHADOW_FACE)
+    FragPos = model * vec4(aPos, 1.0);
+    gl_Position = shadowMatrices[shadowFace] * FragPos;
+#elif defined(VERTEX_LAYER)
+    int face = maskedFace(viewMask, gl_InstanceID);
+    FragPos = model * vec4(aPos, 1.0);
+    gl_Position = shadowMatrices[face] * FragPos;
+    gl_Layer = face;
+#else
     gl_Position = model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+#endif
+}
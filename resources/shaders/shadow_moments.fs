@@ -0,0 +1,61 @@
+#version 330 core
+#pragma features FROM_DEPTH
+// one face of the variance cube (rg::MomentShadowMap): the horizontal pass turns depth into moments,
+// the vertical one finishes the separable Gaussian
+layout (location = 0) out vec2 Moments;
+
+uniform int face;
+// taps each side, 0 only resamples
+uniform int radius;
+
+#ifdef FROM_DEPTH
+// distance / far_plane, as the point shadow pass writes it
+uniform samplerCube depthMap;
+uniform float resolution;
+
+// direction through st ([-1;1]) on a cube face, in GL's face orientation
+vec3 faceDirection(int face, vec2 st)
+{
+    if(face == 0)
+        return vec3(1.0, -st.y, -st.x);
+    if(face == 1)
+        return vec3(-1.0, -st.y, st.x);
+    if(face == 2)
+        return vec3(st.x, 1.0, st.y);
+    if(face == 3)
+        return vec3(st.x, -1.0, -st.y);
+    if(face == 4)
+        return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+#else
+// the horizontal pass, one layer per face
+uniform sampler2DArray horizontal;
+#endif
+
+void main()
+{
+    float sigma = max(float(radius) * 0.5, 0.5);
+    vec2 moments = vec2(0.0);
+    float total = 0.0;
+#ifndef FROM_DEPTH
+    ivec2 size = textureSize(horizontal, 0).xy;
+#endif
+    for(int i = -radius; i <= radius; ++i)
+    {
+        float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+#ifdef FROM_DEPTH
+        // the taps stay on the face, blurring across the seams is not worth the lookups
+        vec2 st = (gl_FragCoord.xy + vec2(float(i), 0.0)) * (2.0 / resolution) - 1.0;
+        st.x = clamp(st.x, -1.0, 1.0);
+        float depth = texture(depthMap, faceDirection(face, st)).r;
+        moments += weight * vec2(depth, depth * depth);
+#else
+        ivec2 texel = ivec2(gl_FragCoord.xy) + ivec2(0, i);
+        texel.y = clamp(texel.y, 0, size.y - 1);
+        moments += weight * texelFetch(horizontal, ivec3(texel, face), 0).rg;
+#endif
+        total += weight;
+    }
+    Moments = moments / total;
+}
@@ -0,0 +1,158 @@
+#version 330 core
+// temporal resolve and upscale (rg::TemporalAA): the current frame reconstructed at the screen pixel from
+// the jittered samples around it, blended with the history fetched along the velocity and clamped to the
+// colors of those samples
+layout (location = 0) out vec4 Resolved;
+
+in vec2 TexCoords;
+
+// the camera passes' targets, screen-sized with the bottom left renderSize rendered
+uniform sampler2D scene;
+uniform sampler2D sceneDepth;
+uniform sampler2D velocity;
+// the last resolve, outputSize
+uniform sampler2D history;
+uniform vec2 renderSize;
+uniform vec2 outputSize;
+// the sub-pixel offset the scene rendered with, in rendered pixels
+uniform vec2 jitter;
+uniform float blend;
+uniform bool historyValid;
+// from this frame's unjittered clip space to last frame's, for the sky which writes no velocity
+uniform mat4 reprojection;
+
+// the clamp works in luma and chroma, where the neighborhood box hugs the colors tighter than in RGB
+vec3 RGBToYCoCg(vec3 c)
+{
+    return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 YCoCgToRGB(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// blended and filtered with HDR squashed into [0, 1), or a single very bright sample outweighs the rest
+vec3 compress(vec3 c)
+{
+    return c / (1.0 + max(c.r, max(c.g, c.b)));
+}
+
+vec3 uncompress(vec3 c)
+{
+    return c / max(1.0 - max(c.r, max(c.g, c.b)), 0.0001);
+}
+
+// Catmull-Rom through the history in 9 bilinear taps, a plain bilinear fetch would blur it a little more
+// every frame
+vec3 sampleHistory(vec2 uv)
+{
+    vec2 samplePosition = uv * outputSize;
+    vec2 texel1 = floor(samplePosition - 0.5) + 0.5;
+    vec2 f = samplePosition - texel1;
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+    vec2 uv0 = (texel1 - 1.0) / outputSize;
+    vec2 uv3 = (texel1 + 2.0) / outputSize;
+    vec2 uv12 = (texel1 + w2 / w12) / outputSize;
+
+    vec3 result = texture(history, vec2(uv0.x, uv0.y)).rgb * w0.x * w0.y;
+    result += texture(history, vec2(uv12.x, uv0.y)).rgb * w12.x * w0.y;
+    result += texture(history, vec2(uv3.x, uv0.y)).rgb * w3.x * w0.y;
+    result += texture(history, vec2(uv0.x, uv12.y)).rgb * w0.x * w12.y;
+    result += texture(history, vec2(uv12.x, uv12.y)).rgb * w12.x * w12.y;
+    result += texture(history, vec2(uv3.x, uv12.y)).rgb * w3.x * w12.y;
+    result += texture(history, vec2(uv0.x, uv3.y)).rgb * w0.x * w3.y;
+    result += texture(history, vec2(uv12.x, uv3.y)).rgb * w12.x * w3.y;
+    result += texture(history, vec2(uv3.x, uv3.y)).rgb * w3.x * w3.y;
+    // the negative lobes can undershoot at hard edges
+    return max(result, vec3(0.0));
+}
+
+// moves c toward the center of the box until it is inside
+vec3 clipToBox(vec3 boxMin, vec3 boxMax, vec3 c)
+{
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extents = max(0.5 * (boxMax - boxMin), vec3(0.00001));
+    vec3 offset = c - center;
+    vec3 units = abs(offset / extents);
+    float outside = max(units.x, max(units.y, units.z));
+    return outside > 1.0 ? center + offset / outside : c;
+}
+
+void main()
+{
+    // the screen pixel's center in rendered pixels
+    vec2 position = TexCoords * renderSize;
+    ivec2 center = ivec2(floor(position));
+    ivec2 lastTexel = ivec2(renderSize) - 1;
+
+    // the 3x3 rendered samples around it: a Gaussian reconstruction of the current frame, the moments and
+    // bounds of the neighborhood, and the closest depth, whose velocity keeps edges from trailing
+    vec3 current = vec3(0.0);
+    float weightSum = 0.0;
+    float nearestWeight = 0.0;
+    vec3 m1 = vec3(0.0);
+    vec3 m2 = vec3(0.0);
+    vec3 minColor = vec3(1.0);
+    vec3 maxColor = vec3(-1.0);
+    float closestDepth = 1.0;
+    ivec2 closest = clamp(center, ivec2(0), lastTexel);
+    for(int y = -1; y <= 1; y++)
+    {
+        for(int x = -1; x <= 1; x++)
+        {
+            ivec2 texel = clamp(center + ivec2(x, y), ivec2(0), lastTexel);
+            vec3 color = RGBToYCoCg(compress(texelFetch(scene, texel, 0).rgb));
+            // where the sample actually landed this frame
+            vec2 d = vec2(texel) + 0.5 - jitter - position;
+            float weight = exp(-2.29 * dot(d, d));
+            current += color * weight;
+            weightSum += weight;
+            nearestWeight = max(nearestWeight, weight);
+            m1 += color;
+            m2 += color * color;
+            minColor = min(minColor, color);
+            maxColor = max(maxColor, color);
+            float depth = texelFetch(sceneDepth, texel, 0).r;
+            if(depth < closestDepth)
+            {
+                closestDepth = depth;
+                closest = texel;
+            }
+        }
+    }
+    current /= weightSum;
+
+    vec2 motion;
+    if(closestDepth < 1.0)
+        motion = texelFetch(velocity, closest, 0).rg;
+    else
+    {
+        // only the sky around: it moves with the camera alone
+        vec4 previous = reprojection * vec4(TexCoords * 2.0 - 1.0, 1.0, 1.0);
+        motion = TexCoords - (previous.xy / previous.w * 0.5 + 0.5);
+    }
+    vec2 previousUV = TexCoords - motion;
+
+    if(!historyValid || any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+    {
+        Resolved = vec4(uncompress(YCoCgToRGB(current)), 1.0);
+        return;
+    }
+
+    // variance box a little wider than the standard deviation, never wider than the samples themselves
+    vec3 mean = m1 / 9.0;
+    vec3 sigma = sqrt(abs(m2 / 9.0 - mean * mean));
+    vec3 boxMin = max(minColor, mean - 1.25 * sigma);
+    vec3 boxMax = min(maxColor, mean + 1.25 * sigma);
+    vec3 previous = clipToBox(boxMin, boxMax, RGBToYCoCg(compress(sampleHistory(previousUV))));
+
+    // a pixel no sample landed near this frame leans on the history more
+    float alpha = blend * mix(0.25, 1.0, nearestWeight);
+    vec3 resolved = mix(previous, current, alpha);
+    Resolved = vec4(uncompress(YCoCgToRGB(resolved)), 1.0);
+}
@@ -12,6 +12,25 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/GLExtensions.h>
+#include <rg/BloomChain.h>
+#include <rg/Bounds.h>
+#include <rg/DynamicResolution.h>
+#include <rg/FrameGraph.h>
+#include <rg/GLState.h>
+#include <rg/Fullscreen.h>
+#include <rg/GpuTimer.h>
+#include <rg/MomentShadowMap.h>
+#include <rg/ObjectTransform.h>
+#include <rg/ParaboloidShadowMap.h>
+#include <rg/PointShadowMap.h>
+#include <rg/ProgramBinaryCache.h>
+#include <rg/RenderQueue.h>
+#include <rg/RenderTargetPool.h>
+#include <rg/RingBuffer.h>
+#include <rg/ShadowAtlas.h>
+#include <rg/StaticScene.h>
+#include <rg/TemporalAA.h>
 
 #include <iostream>
 
@@ -21,8 +40,6 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 unsigned int loadCubemap(vector<std::string> faces);
-//for bloom
-// void renderQuad();
 
 // settings
 const unsigned int SCR_WIDTH = 1920;
@@ -35,12 +52,28 @@ bool blinnKeyPressed = false;
 // shadows
 bool shadows = true;
 bool shadowsKeyPressed = false;
+// how casters reach the cube faces (rg::ShadowMethod), switchable from ImGui
+int shadowMethod = rg::SHADOW_GEOMETRY_SHADER;
+// how the lighting filters the cube (rg::ShadowQuality), switchable from ImGui
+int shadowQuality = rg::SHADOW_QUALITY_HIGH;
+// cycles through the shadow methods and prints their GPU times, started from ImGui
+bool shadowBenchmarkRequested = false;
+// pointLights[0]'s shadow evaluated at half resolution into a screen-space mask instead of per shaded pixel
+bool shadowMask = false;
 // bloom
-//bool bloom = true;
-//bool bloomKeyPressed = false;
+bool bloom = true;
+bool bloomKeyPressed = false;
 float exposure = 1.0f;
+// color grading in the post pass
+float saturation = 1.0f;
+float contrast = 1.0f;
+glm::vec3 tint = glm::vec3(1.0f);
 // lights
-int NR_LIGHTS = 5;
+const int NR_LIGHTS = 5;
+
+// size of the default framebuffer, kept current by framebuffer_size_callback
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 // camera
 float lastX = SCR_WIDTH / 2.0f;
@@ -61,6 +94,39 @@ struct PointLight {
     float linear;
     float quadratic;
 };
+// std140 mirrors of the uniform blocks the shaders declare
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+struct FrameBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float far_plane;
+    // unjittered, for the velocity
+    glm::mat4 viewProjection;
+    glm::mat4 previousViewProjection;
+};
+struct ShadowBlock {
+    glm::mat4 shadowMatrices[6];
+    glm::vec3 lightPos;
+    float far_plane;
+};
+// a model placed in the world, rebuilt every frame
+struct SceneObject {
+    Model *model;
+    glm::mat4 transform;
+    bool visible;
+    bool isStatic;   // drawn into the cached shadow, never moves
+    glm::vec4 bounds;   // local bounding sphere of the model
+};
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -103,7 +169,28 @@ void ProgramState::LoadFromFile(const std::string& filename) {
 }
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState, PointLight *pointLight);
+// the renderer objects the ImGui windows show and tune, gathered once in main()
+struct RendererControls {
+    const rg::RingBuffer &ring;
+    const rg::RenderTargetPool &targetPool;
+    const rg::FrameGraph &frameGraph;
+    rg::PointShadowMap &shadowMap;
+    rg::ShadowAtlas &shadowAtlas;
+    rg::MomentShadowMap &momentMap;
+    rg::BloomChain &bloomChain;
+    rg::DynamicResolution &dynamicResolution;
+    rg::TemporalAA &temporalAA;
+    // one per rg::ShadowMethod
+    const rg::GpuTimer *shadowTimers;
+    const rg::GpuTimer &lightingTimer;
+    const rg::GpuTimer &momentTimer;
+    const rg::GpuTimer &paraboloidTimer;
+    const rg::GpuTimer &shadowMaskTimer;
+    const rg::GpuTimer &bloomTimer;
+    const rg::GpuFrameTimer &frameTimer;
+};
+
+void DrawImGui(ProgramState *programState, PointLight *pointLight, RendererControls &controls);
 
 int main() {
     // glfw: initialize and configure
@@ -126,6 +213,8 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    // not the window size on high-DPI displays
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -139,6 +228,9 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::loadGLExtensions((GLADloadproc) glfwGetProcAddress);
+    // linked programs are cached on disk, later launches skip the driver compiler
+    rg::ProgramBinaryCache::enable("resources/shader_cache");
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -156,13 +248,29 @@ int main() {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
+    // uniform blocks, per-draw object data and the ImGui geometry are streamed through one ring of
+    // per-frame regions, the CPU only waits if the GPU falls a whole ring behind
+    rg::RingBuffer frameRing;
+    frameRing.init(4 << 20);
+    ImGui_ImplOpenGL3_SetStreamAllocator(
+            [](size_t size, size_t alignment, unsigned int *buffer, size_t *offset, void *ring) -> void * {
+                GLintptr start = 0;
+                void *data = ((rg::RingBuffer *)ring)->map(size, alignment, &start);
+                *buffer = ((rg::RingBuffer *)ring)->buffer();
+                *offset = start;
+                return data;
+            },
+            [](void *ring) { ((rg::RingBuffer *)ring)->unmap(); },
+            &frameRing);
+
     // configure global opengl state
-    // depth test, blend, face culling
+    // depth test, face culling
+    // blending and culling are set per mesh from its imported material
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    glEnable(GL_BLEND);
+    glDisable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glEnable(GL_CULL_FACE);
@@ -171,97 +279,154 @@ int main() {
     // build and compile shaders
     // -------------------------
     Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    Shader depthPrepassShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    Shader cutoutPrepassShader("resources/shaders/depth_prepass_cutout.vs", "resources/shaders/depth_prepass_cutout.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader depthShader("resources/shaders/point_shadows.vs", "resources/shaders/point_shadows.fs", "resources/shaders/point_shadows.gs");
-    Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");
-    Shader shaderBloomFinal("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
+    // the same casters without the geometry shader, face by face or layered from the vertex shader
+    Shader faceShadowShader("resources/shaders/point_shadows.vs", "resources/shaders/point_shadows.fs");
+    // depth cube to prefiltered moments, for the variance shadow tier
+    Shader momentShader("resources/shaders/fullscreen.vs", "resources/shaders/shadow_moments.fs");
+    // bloom mip chain and the composite, fullscreen triangles
+    Shader bloomDownsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloom_downsample.fs");
+    Shader bloomUpsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloom_upsample.fs");
+    Shader shaderBloomFinal("resources/shaders/fullscreen.vs", "resources/shaders/bloom_final.fs");
+    // temporal anti-aliasing, resolving the jittered low resolution scene into the screen-sized history
+    Shader taaShader("resources/shaders/fullscreen.vs", "resources/shaders/taa_resolve.fs");
+    // the lighting shader's shadow lookups over the depth buffer at half resolution, its SCREEN_SHADOW variants
+    Shader screenShadowShader("resources/shaders/fullscreen.vs", "resources/shaders/2.model_lighting.fs");
+    // light count is a compile-time constant of every lighting variant
+    ourShader.define("NR_LIGHTS", NR_LIGHTS);
+    screenShadowShader.define("NR_LIGHTS", NR_LIGHTS);
+    // uniform blocks are bound once per frame (or per draw for ObjectData), never per program
+    for (Shader *shader : {&ourShader, &depthPrepassShader, &cutoutPrepassShader, &depthShader, &faceShadowShader,
+                           &screenShadowShader}) {
+        shader->blockBinding("FrameData", rg::FRAME_BLOCK);
+        shader->blockBinding("Lights", rg::LIGHTS_BLOCK);
+        shader->blockBinding("ObjectData", rg::OBJECT_BLOCK);
+        shader->blockBinding("ShadowData", rg::SHADOW_BLOCK);
+    }
+    ourShader.blockBinding("ShadowAtlas", rg::ATLAS_BLOCK);
+
+    // static geometry is drawn with one multi-draw per pass where GL 4.3 (or the ARB extensions) allows it,
+    // the DRAW_INDIRECT variants read the model matrix from a per-draw attribute
+    bool drawStaticIndirect = rg::StaticScene::supported();
+    auto indirectVariant = [&drawStaticIndirect](const Shader &shader) {
+        return drawStaticIndirect ? shader.feature("DRAW_INDIRECT") : 0u;
+    };
+
+    // submit every program before the first one is used, the driver compiles them while
+    // the rest of the setup and the model loading runs; all blinn/shadows combinations are
+    // submitted so toggling them later doesn't hitch
+    unsigned int lightingFeatures = ourShader.feature("BLINN") | ourShader.feature("SHADOWS") |
+                                    ourShader.feature("SHADOW_COMPARE") | ourShader.feature("SHADOW_MOMENTS") |
+                                    ourShader.feature("SHADOW_PARABOLOID") | ourShader.feature("SHADOW_MASK") |
+                                    indirectVariant(ourShader);
+    if (rg::ShadowAtlas::supported())
+        lightingFeatures |= ourShader.feature("SHADOW_ATLAS");
+    // the shadow tiers exclude each other
+    const unsigned int shadowFilterFeatures = ourShader.feature("SHADOW_COMPARE") | ourShader.feature("SHADOW_MOMENTS") |
+                                              ourShader.feature("SHADOW_PARABOLOID");
+    for (unsigned int key = lightingFeatures; ; key = (key - 1) & lightingFeatures) {
+        unsigned int filter = key & shadowFilterFeatures;
+        if ((filter & (filter - 1)) == 0)
+            ourShader.submit(key);
+        if (key == 0)
+            break;
+    }
+    // the pre-pass also in its VELOCITY variants, which write the motion vectors TAA reprojects with
+    for (Shader *shader : {&depthPrepassShader, &cutoutPrepassShader}) {
+        for (unsigned int velocity : {0u, shader->feature("VELOCITY")}) {
+            shader->submit(velocity);
+            shader->submit(velocity | indirectVariant(*shader));
+        }
+    }
+    skyboxShader.submit();
+    depthShader.submit();
+    depthShader.submit(indirectVariant(depthShader));
+    faceShadowShader.submit(faceShadowShader.feature("SHADOW_FACE"));
+    faceShadowShader.submit(faceShadowShader.feature("SHADOW_FACE") | indirectVariant(faceShadowShader));
+    if (rg::PointShadowMap::supported(rg::SHADOW_VERTEX_LAYER))
+        faceShadowShader.submit(faceShadowShader.feature("VERTEX_LAYER"));
+    faceShadowShader.submit(faceShadowShader.feature("PARABOLOID"));
+    momentShader.submit();
+    momentShader.submit(momentShader.feature("FROM_DEPTH"));
+    bloomDownsampleShader.submit();
+    bloomDownsampleShader.submit(bloomDownsampleShader.feature("BRIGHT_PASS"));
+    bloomUpsampleShader.submit();
+    shaderBloomFinal.submit();
+    taaShader.submit();
+    // the mask pass of each shadow tier, named alike in both shaders but at other bits
+    auto screenShadowVariant = [&ourShader, &screenShadowShader](unsigned int lightingKey) {
+        unsigned int key = screenShadowShader.feature("SCREEN_SHADOW");
+        for (const char *tier : {"SHADOW_COMPARE", "SHADOW_MOMENTS", "SHADOW_PARABOLOID"})
+            if (lightingKey & ourShader.feature(tier))
+                key |= screenShadowShader.feature(tier);
+        return key;
+    };
+    for (const char *tier : {"", "SHADOW_COMPARE", "SHADOW_MOMENTS", "SHADOW_PARABOLOID"})
+        screenShadowShader.submit(screenShadowVariant(ourShader.feature(tier)));
 
     // depth
     const unsigned int SHADOW_WIDTH = 1024;
     const unsigned int SHADOW_HEIGHT = 1024;
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-    // create depth cubemap texture
-    unsigned int depthCubemap;
-    glGenTextures(1, &depthCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // configure (floating point) framebuffers
-    // ---------------------------------------
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values)
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-//    unsigned int pingpongFBO[2];
-//    unsigned int pingpongColorbuffers[2];
-//    glGenFramebuffers(2, pingpongFBO);
-//    glGenTextures(2, pingpongColorbuffers);
-//    for (unsigned int i = 0; i < 2; i++)
-//    {
-//        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-//        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-//        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
-//        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-//        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-//        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-//        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-//        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-//        // also check if framebuffers are complete (no need for depth buffer)
-//        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-//            std::cout << "Framebuffer not complete!" << std::endl;
-//    }
-
-    ourShader.use();
-    ourShader.setInt("material.texture_diffuse1", 0);
-    ourShader.setInt("depthMap", 1);
-    ourShader.setInt("NR_LIGHTS", NR_LIGHTS);
-    shaderBlur.use();
-    shaderBlur.setInt("image", 0);
+    // first unit after the ones materials own
+    const int SHADOW_TEXTURE_UNIT = MATERIAL_TEXTURE_UNITS;
+    // depth cubemap, the static casters are cached in a second cube and only redrawn when the light moves
+    rg::PointShadowMap shadowMap;
+    shadowMap.init(SHADOW_WIDTH);
+    // one timer per method, so they can be compared
+    rg::GpuTimer shadowTimers[rg::SHADOW_METHOD_COUNT];
+    for (rg::GpuTimer &timer : shadowTimers)
+        timer.init();
+    // the shaded passes, to compare the quality tiers
+    rg::GpuTimer lightingTimer;
+    lightingTimer.init();
+    // the variance tier's moments, at half the depth cube's resolution since they are blurred anyway
+    rg::MomentShadowMap momentMap;
+    momentMap.init(SHADOW_WIDTH / 2);
+    const int MOMENT_TEXTURE_UNIT = SHADOW_TEXTURE_UNIT + 3;
+    rg::GpuTimer momentTimer;
+    momentTimer.init();
+    // the paraboloid tier renders light 0 into two hemispheres, the cube and its cache are left alone
+    rg::ParaboloidShadowMap paraboloidMap;
+    paraboloidMap.init(SHADOW_WIDTH);
+    const int PARABOLOID_TEXTURE_UNIT = SHADOW_TEXTURE_UNIT + 4;
+    rg::GpuTimer paraboloidTimer;
+    paraboloidTimer.init();
+    // cubes for the other lights, two sharp ones for the lights that matter most on screen and three coarse
+    // ones; without cube map arrays only pointLights[0] casts shadows
+    rg::ShadowAtlas shadowAtlas;
+    const unsigned int atlasResolutions[rg::ShadowAtlas::TIERS] = {1024, 512};
+    const int atlasSlots[rg::ShadowAtlas::TIERS] = {2, 3};
+    shadowAtlas.init(atlasResolutions, atlasSlots);
+    const int ATLAS_HIGH_TEXTURE_UNIT = SHADOW_TEXTURE_UNIT + 1;
+    const int ATLAS_LOW_TEXTURE_UNIT = SHADOW_TEXTURE_UNIT + 2;
+
+    // screen-sized targets come from the pool every frame, a resize reallocates them on first use
+    rg::RenderTargetPool targetPool;
+    // one floating point color buffer, the bright pass reads it in the first bloom downsample; nothing
+    // reads alpha back, so 11/11/10 bit floats instead of RGBA16F halve the bandwidth
+    const GLenum HDR_FORMAT = GL_R11F_G11F_B10F;
+
+    // bloom: the scene goes down a mip chain and back up, nothing runs above half resolution
+    rg::BloomChain bloomChain;
+    const unsigned int brightPassVariant = bloomDownsampleShader.feature("BRIGHT_PASS");
+    rg::GpuTimer bloomTimer;
+    bloomTimer.init();
+
     shaderBloomFinal.use();
     shaderBloomFinal.setInt("scene", 0);
     shaderBloomFinal.setInt("bloomBlur", 1);
 
+    // the half resolution shadow mask
+    const int SHADOW_MASK_TEXTURE_UNIT = SHADOW_TEXTURE_UNIT + 5;
+    rg::GpuTimer shadowMaskTimer;
+    shadowMaskTimer.init();
+
+    // TAA renders the camera passes below the screen size and upscales in its resolve, off by default
+    rg::TemporalAA temporalAA;
+
     float skyboxVertices[] = {
             // positions
             -1.0f,  1.0f, -1.0f,
@@ -344,18 +509,11 @@ int main() {
     bushes.SetShaderTextureNamePrefix("material.");
 
     Model shrek("resources/objects/shrek/shrek.obj");
-    shrek.SetShaderTextureNamePrefix(".material");
-
-    Model vbuck1("resources/objects/vbuck/vbuck.obj");
-    vbuck1.SetShaderTextureNamePrefix(".material");
-    Model vbuck2("resources/objects/vbuck/vbuck.obj");
-    vbuck2.SetShaderTextureNamePrefix(".material");
-    Model vbuck3("resources/objects/vbuck/vbuck.obj");
-    vbuck3.SetShaderTextureNamePrefix(".material");
-    Model vbuck4("resources/objects/vbuck/vbuck.obj");
-    vbuck4.SetShaderTextureNamePrefix(".material");
-    Model vbuck5("resources/objects/vbuck/vbuck.obj");
-    vbuck5.SetShaderTextureNamePrefix(".material");
+    shrek.SetShaderTextureNamePrefix("material.");
+
+    // loaded once, every coin is drawn from the same meshes and textures
+    Model vbuck("resources/objects/vbuck/vbuck.obj");
+    vbuck.SetShaderTextureNamePrefix("material.");
 
     vector<glm::vec3> vbuckPositions;
     for(int i=0; i<NR_LIGHTS; i++) {
@@ -385,6 +543,48 @@ int main() {
         pointLights[i].quadratic = 0.75f;
     }
 
+    // forest, leaves and bushes never move
+    glm::mat4 forest_model = glm::mat4(1.0f);
+    forest_model = glm::scale(forest_model, glm::vec3(8.0f, 8.0f, 8.0f));
+    forest_model = glm::translate(forest_model, glm::vec3(0.0f, 0.0f, 0.0f));
+
+    glm::mat4 leaves_model = glm::mat4(1.0f);
+    leaves_model = glm::scale(leaves_model, glm::vec3(8.0f, 8.0f, 8.0f));
+    leaves_model = glm::translate(leaves_model, glm::vec3(0.0f, 0.0f, 0.0f));
+
+    glm::mat4 bushes_model = glm::mat4(1.0f);
+    bushes_model = glm::scale(bushes_model, glm::vec3(8.0f, 8.0f, 8.0f));
+    bushes_model = glm::translate(bushes_model, glm::vec3(0.0f, 0.0f, 0.0f));
+
+    rg::StaticScene staticScene;
+    staticScene.add(forest, forest_model);
+    staticScene.add(leaves, leaves_model);
+    staticScene.add(bushes, bushes_model);
+    drawStaticIndirect = staticScene.build();
+    const unsigned int depthIndirect = indirectVariant(depthShader);
+    const unsigned int prepassIndirect = indirectVariant(depthPrepassShader);
+    const unsigned int cutoutIndirect = indirectVariant(cutoutPrepassShader);
+    const unsigned int prepassVelocity = depthPrepassShader.feature("VELOCITY");
+    const unsigned int cutoutVelocity = cutoutPrepassShader.feature("VELOCITY");
+    const unsigned int lightingIndirect = indirectVariant(ourShader);
+    const unsigned int faceVariant = faceShadowShader.feature("SHADOW_FACE");
+    const unsigned int faceIndirect = faceVariant | indirectVariant(faceShadowShader);
+    const unsigned int layerVariant = faceShadowShader.feature("VERTEX_LAYER");
+    const unsigned int paraboloidVariant = faceShadowShader.feature("PARABOLOID");
+
+    // local bounding spheres, for culling the shadow casters per cube face
+    const glm::vec4 forestBounds = rg::BoundingSphere(forest);
+    const glm::vec4 leavesBounds = rg::BoundingSphere(leaves);
+    const glm::vec4 bushesBounds = rg::BoundingSphere(bushes);
+    const glm::vec4 shrekBounds = rg::BoundingSphere(shrek);
+    const glm::vec4 vbuckBounds = rg::BoundingSphere(vbuck);
+
+    // shadow benchmark: every supported method in turn, the static cache redrawn every frame
+    const int BENCHMARK_FRAMES = 240;
+    int benchmarkMethod = -1;
+    int benchmarkFrame = 0;
+    int benchmarkSavedMethod = shadowMethod;
+
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -397,13 +597,525 @@ int main() {
     // -----------
     float curPosX = 0.0f;
     float curPosZ = 0.0f;
+    const unsigned int NO_VARIANT = ~0u;
+    unsigned int activeLightingVariant = NO_VARIANT;
+    std::vector<SceneObject> scene;
+    // scene index of light 0's coin, the other lights' coins follow in light order
+    size_t firstCoinObject = 0;
+    // per-object model and normal matrices, indexed like scene
+    std::vector<glm::mat4> sceneModels;
+    std::vector<rg::ObjectTransform> sceneTransforms;
+    std::vector<rg::ShadowCaster> atlasCasters;
+    rg::RenderQueue renderQueue(frameRing);
+    rg::GLState &glState = rg::glState();
+
+    // what the loop prepares every frame for the passes
+    rg::ShadowMethod method = rg::SHADOW_PER_FACE;
+    const float near_plane = 1.0f;
+    const float far_plane = 25.0f;
+    std::vector<glm::mat4> shadowTransforms(6);
+    ShadowBlock shadowBlock;
+    glm::mat4 projection, view;
+    // the camera and the scene's model matrices without jitter, this frame and last, for the velocity
+    glm::mat4 viewProjection, previousViewProjection;
+    std::vector<glm::mat4> previousModels;
+    // the camera passes render the bottom left renderWidth x renderHeight of the screen-sized targets
+    rg::DynamicResolution dynamicResolution;
+    rg::GpuFrameTimer frameTimer;
+    frameTimer.init();
+    unsigned long frameTimerSamples = 0;
+    int renderWidth = 1, renderHeight = 1;
+
+    // the frame's passes, registered once: every frame each declares what it reads and writes, the graph
+    // drops the ones nothing on screen depends on, orders the rest and binds their targets
+    // ---------------------------------------------------------------------------------------------------
+    rg::FrameGraph frameGraph;
+    const rg::FrameResource shadowCube = frameGraph.importTexture("shadow cube", shadowMap.texture());
+    const rg::FrameResource paraboloidLayers = frameGraph.importTexture("paraboloid shadow", paraboloidMap.texture());
+    const rg::FrameResource momentCube = frameGraph.importTexture("moment cube", momentMap.texture());
+    const rg::FrameResource atlasCubes = frameGraph.importTexture("shadow atlas", shadowAtlas.texture(0));
+    const rg::FrameResource hdrColor = frameGraph.createTarget("hdr color", HDR_FORMAT);
+    const rg::FrameResource hdrDepth = frameGraph.createTarget("hdr depth", GL_DEPTH_COMPONENT24, rg::TARGET_NEAREST);
+    const rg::FrameResource velocityTarget = frameGraph.createTarget("velocity", GL_RG16F, rg::TARGET_NEAREST);
+    const rg::FrameResource shadowMaskTarget = frameGraph.createTarget("shadow mask", GL_RG16F, rg::TARGET_NEAREST, 2);
+    // rg::TemporalAA's own targets, alternating every frame; tracked for the ordering only
+    const rg::FrameResource taaHistory = frameGraph.importTexture("taa history", 0);
+    const rg::FrameResource bloomTarget = frameGraph.createTarget("bloom", HDR_FORMAT, rg::TARGET_FILTERED, 2);
+    const rg::FrameResource backbuffer = frameGraph.backbuffer();
+
+    // 1. pointLights[0]'s shadow, the cube or the paraboloids
+    // -------------------------------------------------------
+    frameGraph.addPass("point shadow", [&](rg::FrameGraph::Builder &pass) {
+        pass.write(shadowQuality == rg::SHADOW_QUALITY_PARABOLOID ? paraboloidLayers : shadowCube);
+        // the benchmark times the pass whether or not the lighting samples it
+        if (benchmarkMethod >= 0)
+            pass.sideEffect();
+    }, [&]() {
+        // create depth cubemap transformation matrices, from where the cached static shadow was drawn; the
+        // paraboloids have no cache and follow the light exactly
+        bool paraboloid = shadowQuality == rg::SHADOW_QUALITY_PARABOLOID;
+        bool refreshStaticShadow = !paraboloid && shadowMap.update(pointLights[0].position);
+        glm::vec3 shadowLight = paraboloid ? pointLights[0].position : shadowMap.lightPosition();
+        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
+        shadowTransforms[0] = shadowProj * glm::lookAt(shadowLight, shadowLight + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        shadowTransforms[1] = shadowProj * glm::lookAt(shadowLight, shadowLight + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        shadowTransforms[2] = shadowProj * glm::lookAt(shadowLight, shadowLight + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        shadowTransforms[3] = shadowProj * glm::lookAt(shadowLight, shadowLight + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+        shadowTransforms[4] = shadowProj * glm::lookAt(shadowLight, shadowLight + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        shadowTransforms[5] = shadowProj * glm::lookAt(shadowLight, shadowLight + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+
+        // render scene to depth cubemap
+        // one block serves both the per-draw and the multi-draw variant, and the lighting's lookups
+        for (unsigned int i = 0; i < 6; ++i)
+            shadowBlock.shadowMatrices[i] = shadowTransforms[i];
+        shadowBlock.lightPos = shadowLight;
+        shadowBlock.far_plane = far_plane;
+        frameRing.bindUniformBlock(rg::SHADOW_BLOCK, &shadowBlock, sizeof(shadowBlock));
+        if (!paraboloid) {
+            Shader &casterShader = method == rg::SHADOW_GEOMETRY_SHADER ? depthShader : faceShadowShader;
+            casterShader.select(method == rg::SHADOW_GEOMETRY_SHADER ? 0 : method == rg::SHADOW_PER_FACE ? faceVariant : layerVariant);
+
+            // static casters only when the cached cube is redrawn, dynamic ones every frame; each caster is
+            // tagged with the cube faces its bounding sphere reaches, one that reaches none is dropped
+            renderQueue.clear();
+            for (size_t i = 0; i < scene.size(); i++) {
+                const SceneObject &object = scene[i];
+                if (object.isStatic && (!refreshStaticShadow || (drawStaticIndirect && staticScene.contains(object.model))))
+                    continue;
+                unsigned int faces = rg::PointShadowMap::FaceMask(shadowLight, rg::TransformSphere(object.transform, object.bounds), far_plane);
+                if (faces == 0)
+                    continue;
+                float lightDistance = glm::length(glm::vec3(object.transform[3]) - shadowLight);
+                renderQueue.submit(object.isStatic ? rg::PASS_STATIC_SHADOW : rg::PASS_SHADOW, casterShader, *object.model,
+                                   sceneTransforms[i], lightDistance, rg::ALL_BLEND_MODES, faces);
+            }
+            renderQueue.sort();
+
+            // the geometry shader copies every caster to all six layers; the other methods only draw a caster
+            // into the faces it reaches, the static multi-draws (no per-packet mask) go face by face with a
+            // single-face GPU cull
+            auto drawShadowCasters = [&](rg::RenderPass pass, bool staticCasters) {
+                bool indirect = staticCasters && drawStaticIndirect;
+                if (method == rg::SHADOW_GEOMETRY_SHADER) {
+                    if (indirect) {
+                        staticScene.cull(rg::CULL_SHADOW, shadowTransforms.data(), 6);
+                        depthShader.select(depthIndirect);
+                        staticScene.draw(rg::CULL_SHADOW, depthShader.program(), rg::ALL_BLEND_MODES, false);
+                    }
+                    renderQueue.execute(pass);
+                    return;
+                }
+                if (indirect || method == rg::SHADOW_PER_FACE) {
+                    for (int face = 0; face < 6; face++) {
+                        shadowMap.bind(staticCasters, face);
+                        if (indirect) {
+                            staticScene.cull(rg::CULL_SHADOW, &shadowTransforms[face], 1);
+                            faceShadowShader.select(faceIndirect);
+                            faceShadowShader.use();
+                            faceShadowShader.setInt("shadowFace", face);
+                            staticScene.draw(rg::CULL_SHADOW, faceShadowShader.program(), rg::ALL_BLEND_MODES, false);
+                        }
+                        if (method == rg::SHADOW_PER_FACE) {
+                            faceShadowShader.select(faceVariant);
+                            faceShadowShader.use();
+                            faceShadowShader.setInt("shadowFace", face);
+                            renderQueue.execute(pass, 1u << face);
+                        }
+                    }
+                }
+                if (method == rg::SHADOW_VERTEX_LAYER) {
+                    shadowMap.bind(staticCasters);
+                    renderQueue.execute(pass, rg::ALL_VIEWS, true);
+                }
+            };
+            shadowTimers[method].begin();
+            if (refreshStaticShadow) {
+                shadowMap.beginStatic();
+                drawShadowCasters(rg::PASS_STATIC_SHADOW, true);
+            }
+            shadowMap.beginDynamic();
+            drawShadowCasters(rg::PASS_SHADOW, false);
+            shadowTimers[method].end();
+        } else {
+            // two hemispheres, every caster that reaches one drawn into it
+            faceShadowShader.select(paraboloidVariant);
+            renderQueue.clear();
+            for (size_t i = 0; i < scene.size(); i++) {
+                const SceneObject &object = scene[i];
+                unsigned int hemispheres = rg::ParaboloidShadowMap::HemisphereMask(
+                        shadowLight, rg::TransformSphere(object.transform, object.bounds), far_plane);
+                if (hemispheres == 0)
+                    continue;
+                float lightDistance = glm::length(glm::vec3(object.transform[3]) - shadowLight);
+                renderQueue.submit(rg::PASS_SHADOW, faceShadowShader, *object.model, sceneTransforms[i], lightDistance,
+                                   rg::ALL_BLEND_MODES, hemispheres);
+            }
+            renderQueue.sort();
+            paraboloidTimer.begin();
+            faceShadowShader.use();
+            glState.setEnabled(GL_CLIP_DISTANCE0, true);
+            for (int hemisphere = 0; hemisphere < rg::ParaboloidShadowMap::HEMISPHERES; hemisphere++) {
+                paraboloidMap.begin(hemisphere);
+                faceShadowShader.setInt("hemisphere", hemisphere);
+                renderQueue.execute(rg::PASS_SHADOW, 1u << hemisphere);
+            }
+            glState.setEnabled(GL_CLIP_DISTANCE0, false);
+            paraboloidTimer.end();
+        }
+    });
+
+    // the variance tier filters once here instead of per shaded fragment
+    frameGraph.addPass("shadow moments", [&](rg::FrameGraph::Builder &pass) {
+        pass.read(shadowCube);
+        pass.write(momentCube);
+    }, [&]() {
+        momentTimer.begin();
+        momentMap.filter(shadowMap.texture(), momentShader, momentShader.feature("FROM_DEPTH"), MOMENT_TEXTURE_UNIT);
+        momentTimer.end();
+    });
+
+    frameGraph.addPass("shadow atlas", [&](rg::FrameGraph::Builder &pass) {
+        if (shadowAtlas.enabled())
+            pass.write(atlasCubes);
+    }, [&]() {
+        // the other lights' cubes: the atlas ranks the lights by what they light on screen and schedules
+        // at most faceBudget faces, each drawn with the casters tagged for it
+        glm::mat4 cameraViewProjection = projection * view;
+        atlasCasters.clear();
+        for (int i = 1; i < NR_LIGHTS; i++) {
+            const PointLight &light = pointLights[i];
+            float range = rg::AttenuationRange(light.constant, light.linear, light.quadratic);
+            float intensity = glm::dot(light.diffuse, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+            atlasCasters.push_back({light.position, range, intensity});
+        }
+        // a dynamic caster that jumped (shrek teleporting) left its shadow in the faces it reached and is
+        // missing from the ones it reaches now; spinning and bobbing in place is left to the round-robin
+        if (previousModels.size() == scene.size()) {
+            for (size_t i = 0; i < scene.size(); i++) {
+                const SceneObject &object = scene[i];
+                if (object.isStatic)
+                    continue;
+                glm::vec4 sphere = rg::TransformSphere(object.transform, object.bounds);
+                glm::vec4 previousSphere = rg::TransformSphere(previousModels[i], object.bounds);
+                if (glm::length(glm::vec3(sphere) - glm::vec3(previousSphere)) > 0.1f * sphere.w) {
+                    shadowAtlas.invalidate(previousSphere);
+                    shadowAtlas.invalidate(sphere);
+                }
+            }
+        }
+        shadowAtlas.update(atlasCasters, programState->camera.Position, cameraViewProjection);
+
+        const std::vector<rg::ShadowAtlas::Face> &atlasFaces = shadowAtlas.scheduled();
+        const std::vector<rg::ShadowAtlas::Slot> &slots = shadowAtlas.allSlots();
+        faceShadowShader.select(faceVariant);
+        renderQueue.clear();
+        for (size_t i = 0; i < scene.size(); i++) {
+            const SceneObject &object = scene[i];
+            glm::vec4 sphere = rg::TransformSphere(object.transform, object.bounds);
+            unsigned int views = 0;
+            float lightDistance = far_plane;
+            for (const rg::ShadowAtlas::Face &face : atlasFaces) {
+                const rg::ShadowAtlas::Slot &slot = slots[face.slot];
+                // the light's own coin sits around it and would cover every face; the atlas casters are
+                // the lights from 1 on
+                if (i == firstCoinObject + 1 + slot.light)
+                    continue;
+                float distance = glm::length(glm::vec3(sphere) - slot.position);
+                if (rg::PointShadowMap::FaceMask(slot.position, sphere, slot.range) & (1u << face.face)) {
+                    views |= 1u << (face.slot * 6 + face.face);
+                    lightDistance = std::min(lightDistance, distance);
+                }
+            }
+            if (views == 0)
+                continue;
+            renderQueue.submit(rg::PASS_ATLAS_SHADOW, faceShadowShader, *object.model, sceneTransforms[i],
+                               lightDistance, rg::ALL_BLEND_MODES, views);
+        }
+        renderQueue.sort();
+
+        faceShadowShader.use();
+        int boundSlot = -1;
+        for (const rg::ShadowAtlas::Face &face : atlasFaces) {
+            if (face.slot != boundSlot) {
+                const rg::ShadowAtlas::Slot &slot = slots[face.slot];
+                ShadowBlock slotBlock;
+                shadowAtlas.faceMatrices(face.slot, slotBlock.shadowMatrices);
+                slotBlock.lightPos = slot.position;
+                slotBlock.far_plane = slot.range;
+                frameRing.bindUniformBlock(rg::SHADOW_BLOCK, &slotBlock, sizeof(slotBlock));
+                boundSlot = face.slot;
+            }
+            shadowAtlas.bindFace(face.slot, face.face);
+            faceShadowShader.setInt("shadowFace", face.face);
+            renderQueue.execute(rg::PASS_ATLAS_SHADOW, 1u << (face.slot * 6 + face.face));
+        }
+    });
+
+    // 2. the scene into the HDR target: the depth pre-pass, with the velocity while TAA is on, then the
+    // opaque and blended color passes; the pre-pass fills the queue the color passes draw from
+    // ---------------------------------------------------------------------------------------------------
+    frameGraph.addPass("depth prepass", [&](rg::FrameGraph::Builder &pass) {
+        pass.write(hdrDepth, true);
+        if (temporalAA.enabled)
+            pass.write(velocityTarget, true);
+        pass.viewport(renderWidth, renderHeight);
+    }, [&]() {
+        // the queue draws the per-draw variants, the multi-draws below select their own
+        depthPrepassShader.select(temporalAA.enabled ? prepassVelocity : 0);
+        cutoutPrepassShader.select(temporalAA.enabled ? cutoutVelocity : 0);
+
+        // opaque meshes go through a position-only shader in the pre-pass, cutout meshes through an
+        // alpha-test-only one, so the lighting shader runs at most once per pixel; the queue orders
+        // each pass by state and front to back, the blended pass back to front
+        renderQueue.clear();
+        for (size_t i = 0; i < scene.size(); i++) {
+            const SceneObject &object = scene[i];
+            const rg::ObjectTransform &transform = sceneTransforms[i];
+            if (!object.visible)
+                continue;
+            float viewDistance = glm::length(glm::vec3(object.transform[3]) - programState->camera.Position);
+            // blended meshes need the back to front order, they stay in the queue even for static geometry
+            if (!drawStaticIndirect || !staticScene.contains(object.model)) {
+                renderQueue.submit(rg::PASS_DEPTH_PREPASS, depthPrepassShader, *object.model, transform, viewDistance,
+                                   rg::BlendMask(BLEND_OPAQUE), rg::ALL_VIEWS, &previousModels[i]);
+                renderQueue.submit(rg::PASS_DEPTH_PREPASS, cutoutPrepassShader, *object.model, transform, viewDistance,
+                                   rg::BlendMask(BLEND_CUTOUT), rg::ALL_VIEWS, &previousModels[i]);
+                renderQueue.submit(rg::PASS_OPAQUE, ourShader, *object.model, transform, viewDistance, rg::BlendMask(BLEND_OPAQUE) | rg::BlendMask(BLEND_CUTOUT));
+            }
+            renderQueue.submit(rg::PASS_BLENDED, ourShader, *object.model, transform, viewDistance, rg::BlendMask(BLEND_BLENDED));
+        }
+        renderQueue.sort();
+
+        // only the velocity target takes color, the sky leaves it at the clear color and is reprojected
+        // from the camera alone
+        glState.colorMask(temporalAA.enabled);
+        if (drawStaticIndirect) {
+            staticScene.cull(rg::CULL_CAMERA, &viewProjection, 1);
+            depthPrepassShader.select(prepassIndirect | (temporalAA.enabled ? prepassVelocity : 0));
+            staticScene.draw(rg::CULL_CAMERA, depthPrepassShader.program(), rg::BlendMask(BLEND_OPAQUE), false);
+            cutoutPrepassShader.select(cutoutIndirect | (temporalAA.enabled ? cutoutVelocity : 0));
+            staticScene.draw(rg::CULL_CAMERA, cutoutPrepassShader.program(), rg::BlendMask(BLEND_CUTOUT), true);
+        }
+        renderQueue.execute(rg::PASS_DEPTH_PREPASS);
+        glState.colorMask(true);
+    });
+
+    // pointLights[0]'s shadow map of the lighting variant on screen, only the sampled one keeps its passes
+    auto readPointShadow = [&](rg::FrameGraph::Builder &pass) {
+        if (!(activeLightingVariant & ourShader.feature("SHADOWS")))
+            return;
+        if (activeLightingVariant & ourShader.feature("SHADOW_MOMENTS"))
+            pass.read(momentCube);
+        else if (activeLightingVariant & ourShader.feature("SHADOW_PARABOLOID"))
+            pass.read(paraboloidLayers);
+        else
+            pass.read(shadowCube);
+    };
+    auto bindPointShadow = [&]() {
+        glState.bindTexture(PARABOLOID_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, paraboloidMap.texture());
+        glState.bindTexture(MOMENT_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, momentMap.texture());
+        glState.bindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, shadowMap.texture());
+        // the compare variants need the depth compare, the reference path reads raw depth
+        bool compareShadows = (activeLightingVariant & ourShader.feature("SHADOW_COMPARE")) != 0;
+        glBindSampler(SHADOW_TEXTURE_UNIT, compareShadows ? shadowMap.compareSampler() : 0);
+    };
+    auto setPointShadowUniforms = [&](Shader &shader) {
+        shader.setInt("depthMap", SHADOW_TEXTURE_UNIT);
+        shader.setInt("shadowSamples", rg::ShadowQualitySamples((rg::ShadowQuality)shadowQuality));
+        shader.setInt("momentMap", MOMENT_TEXTURE_UNIT);
+        shader.setFloat("minVariance", momentMap.minVariance);
+        shader.setFloat("bleedReduction", momentMap.bleedReduction);
+        shader.setInt("paraboloidMap", PARABOLOID_TEXTURE_UNIT);
+    };
+
+    // the SHADOW_MASK variants read pointLights[0]'s shadow from a half resolution mask, evaluated over the
+    // pre-pass depth a quarter as many times as the color pass would
+    frameGraph.addPass("shadow mask", [&](rg::FrameGraph::Builder &pass) {
+        if (!(activeLightingVariant & ourShader.feature("SHADOW_MASK")))
+            return;
+        readPointShadow(pass);
+        pass.read(hdrDepth);
+        pass.write(shadowMaskTarget);
+        pass.viewport(renderWidth / 2, renderHeight / 2);
+    }, [&]() {
+        shadowMaskTimer.begin();
+        glState.setEnabled(GL_DEPTH_TEST, false);
+        bindPointShadow();
+        glState.bindTexture(0, GL_TEXTURE_2D, frameGraph.texture(hdrDepth));
+        screenShadowShader.select(screenShadowVariant(activeLightingVariant));
+        screenShadowShader.use();
+        setPointShadowUniforms(screenShadowShader);
+        screenShadowShader.setInt("sceneDepth", 0);
+        screenShadowShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        screenShadowShader.setVec2("renderSize", glm::vec2(renderWidth, renderHeight));
+        rg::DrawFullscreenTriangle();
+        glState.setEnabled(GL_DEPTH_TEST, true);
+        shadowMaskTimer.end();
+    });
+
+    frameGraph.addPass("scene", [&](rg::FrameGraph::Builder &pass) {
+        pass.write(hdrColor, true);
+        // the pre-pass's depth, the color pass only shades what is equal to it
+        pass.read(hdrDepth);
+        pass.write(hdrDepth);
+        pass.viewport(renderWidth, renderHeight);
+        // the mask still falls back to the shadow map on pixels it has no sample for
+        readPointShadow(pass);
+        if (activeLightingVariant & ourShader.feature("SHADOW_MASK"))
+            pass.read(shadowMaskTarget);
+        if (activeLightingVariant & ourShader.feature("SHADOW_ATLAS"))
+            pass.read(atlasCubes);
+    }, [&]() {
+        // the lighting looks pointLights[0] up through ShadowData, the atlas pass bound its slots' blocks
+        frameRing.bindUniformBlock(rg::SHADOW_BLOCK, &shadowBlock, sizeof(shadowBlock));
+        if (shadowAtlas.enabled()) {
+            // indexed like pointLights, pointLights[0] has its own cube
+            rg::ShadowSlotBlock atlasBlock[NR_LIGHTS];
+            atlasBlock[0] = {glm::vec4(0.0f), -1, 0, {0, 0}};
+            shadowAtlas.slotBlocks(atlasBlock + 1, NR_LIGHTS - 1);
+            frameRing.bindUniformBlock(rg::ATLAS_BLOCK, atlasBlock, sizeof(atlasBlock));
+            glState.bindTexture(ATLAS_HIGH_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, shadowAtlas.texture(0));
+            glState.bindTexture(ATLAS_LOW_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, shadowAtlas.texture(1));
+        }
+        // the sampler unit is still a plain uniform; the per-draw variant stays selected
+        for (unsigned int key : {activeLightingVariant | lightingIndirect, activeLightingVariant}) {
+            ourShader.select(key);
+            ourShader.use();
+            setPointShadowUniforms(ourShader);
+            ourShader.setInt("shadowAtlasHigh", ATLAS_HIGH_TEXTURE_UNIT);
+            ourShader.setInt("shadowAtlasLow", ATLAS_LOW_TEXTURE_UNIT);
+            ourShader.setInt("shadowMask", SHADOW_MASK_TEXTURE_UNIT);
+            ourShader.setVec2("shadowMaskSize", glm::vec2(renderWidth / 2, renderHeight / 2));
+        }
+        bindPointShadow();
+        if (activeLightingVariant & ourShader.feature("SHADOW_MASK"))
+            glState.bindTexture(SHADOW_MASK_TEXTURE_UNIT, GL_TEXTURE_2D, frameGraph.texture(shadowMaskTarget));
+
+        // color pass, only fragments that won the pre-pass get shaded
+        lightingTimer.begin();
+        glState.depthMask(false);
+        glState.depthFunc(GL_EQUAL);
+        if (drawStaticIndirect) {
+            ourShader.select(activeLightingVariant | lightingIndirect);
+            staticScene.draw(rg::CULL_CAMERA, ourShader.program(), rg::BlendMask(BLEND_OPAQUE) | rg::BlendMask(BLEND_CUTOUT), true);
+        }
+        renderQueue.execute(rg::PASS_OPAQUE);
+
+        // blended materials are not in the pre-pass, test them against it and blend on top
+        glState.depthFunc(GL_LESS);
+        glState.setEnabled(GL_BLEND, true);
+        renderQueue.execute(rg::PASS_BLENDED);
+        glState.setEnabled(GL_BLEND, false);
+        lightingTimer.end();
+
+        glState.depthMask(true);
+    });
+
+    frameGraph.addPass("skybox", [&](rg::FrameGraph::Builder &pass) {
+        pass.write(hdrColor);
+        pass.write(hdrDepth);
+        pass.viewport(renderWidth, renderHeight);
+    }, [&]() {
+        // skybox
+        glState.depthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+        skyboxShader.use();
+        glm::mat4 skyboxView = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
+        skyboxShader.setMat4("view", skyboxView);
+        skyboxShader.setMat4("projection", projection);
+        // skybox cube
+        glState.bindVertexArray(skyboxVAO);
+        glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glState.depthFunc(GL_LESS); // set depth function back to default
+    });
+
+    // 3. TAA: the jittered scene reconstructed at the screen size and blended into the history
+    // ----------------------------------------------------------------------------------------
+    frameGraph.addPass("temporal resolve", [&](rg::FrameGraph::Builder &pass) {
+        if (!temporalAA.enabled)
+            return;
+        pass.read(hdrColor);
+        pass.read(hdrDepth);
+        pass.read(velocityTarget);
+        pass.write(taaHistory);
+    }, [&]() {
+        temporalAA.resolve(targetPool, taaShader, frameGraph.texture(hdrColor), frameGraph.texture(hdrDepth),
+                           frameGraph.texture(velocityTarget), renderWidth, renderHeight, viewProjection,
+                           previousViewProjection, 0);
+    });
+
+    // with TAA on, the post passes read its screen-sized output instead of the rendered part of the HDR target
+    auto postSource = [&]() {
+        return temporalAA.enabled ? taaHistory : hdrColor;
+    };
+    auto postRegion = [&]() {
+        if (temporalAA.enabled)
+            return glm::vec2(1.0f);
+        return glm::vec2((float) renderWidth / targetPool.width(), (float) renderHeight / targetPool.height());
+    };
+
+    // 4. bloom, the bright pass is part of its first downsample
+    // ---------------------------------------------------------
+    frameGraph.addPass("bloom", [&](rg::FrameGraph::Builder &pass) {
+        pass.read(postSource());
+        pass.write(bloomTarget);
+    }, [&]() {
+        bloomTimer.begin();
+        unsigned int source = temporalAA.enabled ? temporalAA.output() : frameGraph.texture(hdrColor);
+        bloomChain.render(targetPool, source, targetPool.width(), targetPool.height(), postRegion(),
+                          frameGraph.texture(bloomTarget), HDR_FORMAT, bloomDownsampleShader, brightPassVariant,
+                          bloomUpsampleShader, 0);
+        bloomTimer.end();
+    });
+
+    // 5. one fullscreen triangle: bloom composite, tone mapping to the default framebuffer's (clamped) color range, grading, gamma
+    // ------------------------------------------------------------------------------------------------------------------------
+    frameGraph.addPass("composite", [&](rg::FrameGraph::Builder &pass) {
+        pass.read(postSource());
+        if (bloom)
+            pass.read(bloomTarget);
+        pass.write(backbuffer);
+    }, [&]() {
+        glState.setEnabled(GL_DEPTH_TEST, false);
+        shaderBloomFinal.use();
+        glState.bindTexture(0, GL_TEXTURE_2D, temporalAA.enabled ? temporalAA.output() : frameGraph.texture(hdrColor));
+        if (bloom)
+            glState.bindTexture(1, GL_TEXTURE_2D, frameGraph.texture(bloomTarget));
+        // the upscale from the dynamic resolution is the bilinear fetch of the scene, TAA did its own
+        glm::vec2 screenSize((float) targetPool.width(), (float) targetPool.height());
+        glm::vec2 sceneScale = postRegion();
+        shaderBloomFinal.setVec2("sceneScale", sceneScale);
+        shaderBloomFinal.setVec2("sceneMax", sceneScale - 0.5f / screenSize);
+        shaderBloomFinal.setInt("bloom", bloom);
+        shaderBloomFinal.setFloat("exposure", exposure);
+        shaderBloomFinal.setFloat("bloomStrength", bloomChain.strength);
+        shaderBloomFinal.setFloat("saturation", saturation);
+        shaderBloomFinal.setFloat("contrast", contrast);
+        shaderBloomFinal.setVec3("tint", tint);
+        rg::DrawFullscreenTriangle();
+        glState.setEnabled(GL_DEPTH_TEST, true);
+    });
+
+    RendererControls imguiControls = {frameRing, targetPool, frameGraph, shadowMap, shadowAtlas, momentMap, bloomChain,
+                                      dynamicResolution, temporalAA, shadowTimers, lightingTimer, momentTimer,
+                                      paraboloidTimer, shadowMaskTimer, bloomTimer, frameTimer};
+    frameGraph.addPass("imgui", [&](rg::FrameGraph::Builder &pass) {
+        if (programState->ImGuiEnabled)
+            pass.write(backbuffer);
+    }, [&]() {
+        DrawImGui(programState, &pointLights[0], imguiControls);
+    });
+
+    // setup above binds textures, buffers and VAOs directly, from here on state goes through the cache
+    glState.invalidate();
     while (!glfwWindowShouldClose(window)) {
-        bool shouldDiscard = false;
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        targetPool.beginFrame(framebufferWidth, framebufferHeight);
+        temporalAA.beginFrame(targetPool);
 
         // Is current frame count divisible by frequency?
         int lightOffCond = (int(currentFrame) % flickerOccurrenceFrequency == 0);
@@ -411,64 +1123,71 @@ int main() {
         // input
         // -----
         processInput(window);
+        glState.resetCounters();
+        frameRing.beginFrame();
+        // the scale that would have kept the last measured frame inside the GPU budget, stepped once per
+        // measurement; the timestamps arrive a few frames late and not every frame
+        bool frameTimeArrived = frameTimer.sampleCount() != frameTimerSamples;
+        frameTimerSamples = frameTimer.sampleCount();
+        dynamicResolution.update(frameTimeArrived ? frameTimer.lastMilliseconds() : 0.0);
+        // TAA renders below that and makes up the difference in its resolve
+        float taaScale = temporalAA.enabled ? temporalAA.renderScale : 1.0f;
+        renderWidth = dynamicResolution.scaled(targetPool.width(), taaScale);
+        renderHeight = dynamicResolution.scaled(targetPool.height(), taaScale);
+        frameTimer.begin();
 
         // render
         // ------
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // create depth cubemap transformation matrices
-        float near_plane = 1.0f;
-        float far_plane = 25.0f;
-        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
-        std::vector<glm::mat4> shadowTransforms;
-        shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+        // shadow benchmark step: the next method every BENCHMARK_FRAMES frames, report at the end
+        if (shadowBenchmarkRequested && benchmarkMethod < 0) {
+            benchmarkSavedMethod = shadowMethod;
+            benchmarkMethod = 0;
+            benchmarkFrame = 0;
+        }
+        shadowBenchmarkRequested = false;
+        if (benchmarkMethod >= 0) {
+            if (benchmarkFrame == BENCHMARK_FRAMES) {
+                benchmarkFrame = 0;
+                benchmarkMethod++;
+            }
+            while (benchmarkMethod < rg::SHADOW_METHOD_COUNT && !rg::PointShadowMap::supported((rg::ShadowMethod)benchmarkMethod))
+                benchmarkMethod++;
+            if (benchmarkMethod == rg::SHADOW_METHOD_COUNT) {
+                const char *names[] = {"geometry shader", "per face", "vertex layer"};
+                std::cout << "shadow pass, static casters redrawn every frame:" << std::endl;
+                for (int method = 0; method < rg::SHADOW_METHOD_COUNT; method++)
+                    if (rg::PointShadowMap::supported((rg::ShadowMethod)method))
+                        std::cout << "  " << names[method] << ": " << shadowTimers[method].milliseconds() << " ms" << std::endl;
+                shadowMethod = benchmarkSavedMethod;
+                benchmarkMethod = -1;
+            } else {
+                shadowMethod = benchmarkMethod;
+                benchmarkFrame++;
+                shadowMap.invalidate();
+            }
+        }
+        method = (rg::ShadowMethod)shadowMethod;
+        if (!rg::PointShadowMap::supported(method))
+            method = rg::SHADOW_PER_FACE;
 
-        // render scene to depth cubemap
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        depthShader.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            depthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        depthShader.setFloat("far_plane", far_plane);
-        depthShader.setVec3("lightPos", pointLights[0].position);
-
-        // forest model
-        glm::mat4 forest_model = glm::mat4(1.0f);
-        forest_model = glm::scale(forest_model, glm::vec3(8.0f, 8.0f, 8.0f));
-        forest_model = glm::translate(forest_model, glm::vec3(0.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", forest_model);
-        forest.Draw(ourShader);
-
-        // leaves model
-        glCullFace(GL_FRONT);
-        glm::mat4 leaves_model = glm::mat4(1.0f);
-        leaves_model = glm::scale(leaves_model, glm::vec3(8.0f, 8.0f, 8.0f));
-        leaves_model = glm::translate(leaves_model, glm::vec3(0.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", leaves_model);
-        leaves.Draw(ourShader);
-        glCullFace(GL_BACK);
-
-        // bushes model
-        glDisable(GL_CULL_FACE);
-        glm::mat4 bushes_model = glm::mat4(1.0f);
-        bushes_model = glm::scale(bushes_model, glm::vec3(8.0f, 8.0f, 8.0f));
-        bushes_model = glm::translate(bushes_model, glm::vec3(0.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", bushes_model);
-        bushes.Draw(ourShader);
-        glEnable(GL_CULL_FACE);
+        // If lightCond applies light is placed out of reach for this frame.
+        pointLights[0].position = glm::vec3(curPosX + moveLightX, 4.5f + cos(currentFrame/4)/4 , curPosZ + moveLightZ);
+        if(lightOffCond && lightOffFrameCount < flickerFrequency) {
+            pointLights[0].position.y = -20.0f;
+            lightOffFrameCount++;
+        }
+        else {
+            pointLights[0].position.y = 4.5f + cos(currentFrame/4)/4;
+            lightOffFrameCount = 0;
+        }
+        for(int i=0; i<NR_LIGHTS; i++)
+            vbuckPositions[i][1] = 1.5f + cos(currentFrame*2)/8;
 
+        // scene transforms
+        // ----------------
         // shrek model
-        if(lightOffCond) {
-            shouldDiscard = true;
-        }
-        ourShader.setBool("shouldDiscard", shouldDiscard);
         glm::mat4 shrek_model = glm::mat4(1.0f);
 
         float camX = programState->camera.Position.x;
@@ -495,181 +1214,96 @@ int main() {
             shrek_model = glm::rotate(shrek_model, glm::radians((float)rng2), glm::vec3(0, 1.0f, 0));
             shrek_model = glm::rotate(shrek_model, glm::radians((float)rng3), glm::vec3(0, 0, 0.25f));
         }
-        ourShader.setMat4("model", shrek_model);
-        shrek.Draw(ourShader);
-
-        shouldDiscard = false;
-        ourShader.setBool("shouldDiscard", shouldDiscard);
-
-        // vbuck models
-        glm::mat4 vbuck_model1 = glm::mat4(1.0f);
-        vbuck_model1 = glm::translate(vbuck_model1, vbuckPositions[0]);
-        vbuck_model1 = glm::scale(vbuck_model1, glm::vec3(0.05f, 0.05f, 0.05f));
-        vbuck_model1 = glm::rotate(vbuck_model1, glm::radians(125*currentFrame), glm::vec3(0, 1.0f, 0));
-        ourShader.setMat4("model", vbuck_model1);
-        vbuck1.Draw(ourShader);
-        glm::mat4 vbuck_model2 = glm::mat4(1.0f);
-        vbuck_model2 = glm::translate(vbuck_model2, vbuckPositions[1]);
-        vbuck_model2 = glm::scale(vbuck_model2, glm::vec3(0.05f, 0.05f, 0.05f));
-        vbuck_model2 = glm::rotate(vbuck_model2, glm::radians(125*currentFrame), glm::vec3(0, 1.0f, 0));
-        ourShader.setMat4("model", vbuck_model2);
-        vbuck2.Draw(ourShader);
-        glm::mat4 vbuck_model3 = glm::mat4(1.0f);
-        vbuck_model3 = glm::translate(vbuck_model3, vbuckPositions[2]);
-        vbuck_model3 = glm::scale(vbuck_model3, glm::vec3(0.05f, 0.05f, 0.05f));
-        vbuck_model3 = glm::rotate(vbuck_model3, glm::radians(125*currentFrame), glm::vec3(0, 1.0f, 0));
-        ourShader.setMat4("model", vbuck_model3);
-        vbuck3.Draw(ourShader);
-        glm::mat4 vbuck_model4 = glm::mat4(1.0f);
-        vbuck_model4 = glm::translate(vbuck_model4, vbuckPositions[3]);
-        vbuck_model4 = glm::scale(vbuck_model4, glm::vec3(0.05f, 0.05f, 0.05f));
-        vbuck_model4 = glm::rotate(vbuck_model4, glm::radians(125*currentFrame), glm::vec3(0, 1.0f, 0));
-        ourShader.setMat4("model", vbuck_model4);
-        vbuck4.Draw(ourShader);
-        glm::mat4 vbuck_model5 = glm::mat4(1.0f);
-        vbuck_model5 = glm::translate(vbuck_model5, vbuckPositions[4]);
-        vbuck_model5 = glm::scale(vbuck_model5, glm::vec3(0.05f, 0.05f, 0.05f));
-        vbuck_model5 = glm::rotate(vbuck_model5, glm::radians(125*currentFrame), glm::vec3(0, 1.0f, 0));
-        ourShader.setMat4("model", vbuck_model5);
-        vbuck5.Draw(ourShader);
 
-        // If lightCond applies light is placed out of reach for this frame.
-        // view/projection transformations
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        ourShader.use();
-        pointLights[0].position = glm::vec3(curPosX + moveLightX, 4.5f + cos(currentFrame/4)/4 , curPosZ + moveLightZ);
-        if(lightOffCond && lightOffFrameCount < flickerFrequency) {
-            pointLights[0].position.y = -20.0f;
-            lightOffFrameCount++;
-        }
-        else {
-            pointLights[0].position.y = 4.5f + cos(currentFrame/4)/4;
-            lightOffFrameCount = 0;
-        }
+        scene.clear();
+        scene.push_back({&forest, forest_model, true, true, forestBounds});
+        scene.push_back({&leaves, leaves_model, true, true, leavesBounds});
+        scene.push_back({&bushes, bushes_model, true, true, bushesBounds});
+        size_t shrekObject = scene.size();
+        scene.push_back({&shrek, shrek_model, true, false, shrekBounds});
+        // shrek is hidden while the light flickers off
+        scene[shrekObject].visible = !(lightOffCond && lightOffFrameCount < flickerFrequency);
+        // vbuck models, every coin shares the one imported model
+        firstCoinObject = scene.size();
         for(int i=0; i<NR_LIGHTS; i++) {
-            vbuckPositions[i][1] = 1.5f + cos(currentFrame*2)/8;
-            ourShader.setVec3("pointLights[" + std::to_string(i) + "].position", pointLights[i].position);
-            ourShader.setVec3("pointLights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
-            ourShader.setVec3("pointLights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
-            ourShader.setVec3("pointLights[" + std::to_string(i) + "].specular", pointLights[i].specular);
-            ourShader.setFloat("pointLights[" + std::to_string(i) + "].constant", pointLights[i].constant);
-            ourShader.setFloat("pointLights[" + std::to_string(i) + "].linear", pointLights[i].linear);
-            ourShader.setFloat("pointLights[" + std::to_string(i) + "].quadratic", pointLights[i].quadratic);
+            glm::mat4 vbuck_model = glm::mat4(1.0f);
+            vbuck_model = glm::translate(vbuck_model, vbuckPositions[i]);
+            vbuck_model = glm::scale(vbuck_model, glm::vec3(0.05f, 0.05f, 0.05f));
+            vbuck_model = glm::rotate(vbuck_model, glm::radians(125*currentFrame), glm::vec3(0, 1.0f, 0));
+            scene.push_back({&vbuck, vbuck_model, true, false, vbuckBounds});
         }
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-        ourShader.setInt("blinn", blinn);
-        ourShader.setBool("shadows", shadows);
-        ourShader.setFloat("far_plane", far_plane);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // forest model
-        ourShader.setMat4("model", forest_model);
-        forest.Draw(ourShader);
-
-        // leaves model
-        glCullFace(GL_FRONT);
-        ourShader.setMat4("model", leaves_model);
-        leaves.Draw(ourShader);
-        glCullFace(GL_BACK);
-
-        //bushes model
-        glDisable(GL_CULL_FACE);
-        ourShader.setMat4("model", bushes_model);
-        bushes.Draw(ourShader);
-        glEnable(GL_CULL_FACE);
+        // normal matrices of the whole scene in one batch, the shaders no longer invert per vertex
+        sceneModels.clear();
+        for (const SceneObject &object : scene)
+            sceneModels.push_back(object.transform);
+        sceneTransforms.resize(scene.size());
+        rg::ComputeObjectTransforms(sceneModels.data(), sceneTransforms.data(), scene.size());
 
-        // shrek model
-        if(lightOffCond && lightOffFrameCount < flickerFrequency) {
-            shouldDiscard = true;
+        // view/projection transformations
+        projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                      (float) framebufferWidth / (float) std::max(framebufferHeight, 1), 0.1f, 100.0f);
+        view = programState->camera.GetViewMatrix();
+        viewProjection = projection * view;
+        // last frame's camera and objects, for the velocity; on the first frame nothing moved
+        if (previousModels.size() != sceneModels.size()) {
+            previousModels = sceneModels;
+            previousViewProjection = viewProjection;
         }
-        ourShader.setBool("shouldDiscard", shouldDiscard);
-        if(lightOffFrameCount >= flickerFrequency) {
-            auto rng1 = (float)(random() % 61 - 30);
-            auto rng2 = (float)(random() % 61 - 30);
-            auto rng3 = (float)(random() % 61 - 30);
-            shrek_model = glm::inverse(glm::lookAt(glm::vec3(curPosX + rng1/30, 0.1f + rng2/90, curPosZ + rng3/30), programState->camera.Position, glm::vec3(0.0f, 1.0f, 0.0f)));
-            shrek_model = glm::rotate(shrek_model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, -0.2f));
-            shrek_model = glm::scale(shrek_model, glm::vec3(2.8f, 2.8f, 2.8f));
-            shrek_model = glm::rotate(shrek_model, glm::radians((float)rng1), glm::vec3(0.25f, 0, 0));
-            shrek_model = glm::rotate(shrek_model, glm::radians((float)rng2), glm::vec3(0, 1.0f, 0));
-            shrek_model = glm::rotate(shrek_model, glm::radians((float)rng3), glm::vec3(0, 0, 0.25f));
+        // every camera pass renders with the sub-pixel offset of this frame's TAA sample, the velocity and
+        // the culling go without it
+        projection = rg::TemporalAA::Jitter(projection, temporalAA.jitter(), renderWidth, renderHeight);
+
+        // camera and lights go out as two blocks every camera-pass program reads
+        FrameBlock frameBlock;
+        frameBlock.projection = projection;
+        frameBlock.view = view;
+        frameBlock.viewPosition = programState->camera.Position;
+        frameBlock.far_plane = far_plane;
+        frameBlock.viewProjection = viewProjection;
+        frameBlock.previousViewProjection = previousViewProjection;
+        frameRing.bindUniformBlock(rg::FRAME_BLOCK, &frameBlock, sizeof(frameBlock));
+        PointLightBlock lightsBlock[NR_LIGHTS];
+        for(int i=0; i<NR_LIGHTS; i++) {
+            lightsBlock[i].position = pointLights[i].position;
+            lightsBlock[i].ambient = pointLights[i].ambient;
+            lightsBlock[i].diffuse = pointLights[i].diffuse;
+            lightsBlock[i].specular = pointLights[i].specular;
+            lightsBlock[i].constant = pointLights[i].constant;
+            lightsBlock[i].linear = pointLights[i].linear;
+            lightsBlock[i].quadratic = pointLights[i].quadratic;
+            lightsBlock[i].padding = 0.0f;
         }
-        ourShader.setMat4("model", shrek_model);
-        shrek.Draw(ourShader);
-        shouldDiscard = false;
-        ourShader.setBool("shouldDiscard", shouldDiscard);
-
-        //vbuck model
-        ourShader.setMat4("model", vbuck_model1);
-        vbuck1.Draw(ourShader);
-        ourShader.setMat4("model", vbuck_model2);
-        vbuck2.Draw(ourShader);
-        ourShader.setMat4("model", vbuck_model3);
-        vbuck3.Draw(ourShader);
-        ourShader.setMat4("model", vbuck_model4);
-        vbuck4.Draw(ourShader);
-        ourShader.setMat4("model", vbuck_model5);
-        vbuck5.Draw(ourShader);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // 2. blur bright fragments with two-pass Gaussian Blur
-        // --------------------------------------------------
-//        bool horizontal = true, first_iteration = true;
-//        unsigned int amount = 10;
-//        shaderBlur.use();
-//        for (unsigned int i = 0; i < amount; i++)
-//        {
-//            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-//            shaderBlur.setInt("horizontal", horizontal);
-//            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-//            renderQuad();
-//            horizontal = !horizontal;
-//            if (first_iteration)
-//                first_iteration = false;
-//        }
-//        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-//
-//        // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
-//        // --------------------------------------------------------------------------------------------------------------------------
-//        shaderBloomFinal.use();
-//        glActiveTexture(GL_TEXTURE0);
-//        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-//        glActiveTexture(GL_TEXTURE1);
-//        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-//        shaderBloomFinal.setInt("bloom", bloom);
-//        shaderBloomFinal.setFloat("exposure", exposure);
-//        renderQuad();
-//
-//        std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
-
-        // skybox
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState, &pointLights[0]);
+        frameRing.bindUniformBlock(rg::LIGHTS_BLOCK, lightsBlock, sizeof(lightsBlock));
+
+        // blinn and shadows pick a compiled variant instead of branching in the shader
+        unsigned int lightingVariant = 0;
+        if(blinn)
+            lightingVariant |= ourShader.feature("BLINN");
+        if(shadows)
+            lightingVariant |= ourShader.feature("SHADOWS");
+        if(shadows && shadowAtlas.enabled())
+            lightingVariant |= ourShader.feature("SHADOW_ATLAS");
+        if(shadows && shadowQuality == rg::SHADOW_QUALITY_VARIANCE)
+            lightingVariant |= ourShader.feature("SHADOW_MOMENTS");
+        else if(shadows && shadowQuality == rg::SHADOW_QUALITY_PARABOLOID)
+            lightingVariant |= ourShader.feature("SHADOW_PARABOLOID");
+        else if(shadows && shadowQuality != rg::SHADOW_QUALITY_REFERENCE)
+            lightingVariant |= ourShader.feature("SHADOW_COMPARE");
+        if(shadows && shadowMask)
+            lightingVariant |= ourShader.feature("SHADOW_MASK");
+        // a variant still in the driver compiler keeps the previous one on screen instead of stalling the frame
+        ourShader.submit(lightingVariant);
+        ourShader.submit(lightingVariant | lightingIndirect);
+        if (activeLightingVariant == NO_VARIANT ||
+            (ourShader.ready(lightingVariant) && ourShader.ready(lightingVariant | lightingIndirect)))
+            activeLightingVariant = lightingVariant;
+
+        frameGraph.execute(targetPool);
+        frameTimer.end();
+        previousViewProjection = viewProjection;
+        previousModels = sceneModels;
+        // everything streamed this frame is fenced, its region is reused FRAMES frames from now
+        frameRing.endFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -715,13 +1349,13 @@ void processInput(GLFWwindow *window) {
         blinnKeyPressed = false;
 
     // bloom
-//    if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS && !bloomKeyPressed)
-//    {
-//        bloom = !bloom;
-//        bloomKeyPressed = true;
-//    }
-//    if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_RELEASE)
-//        bloomKeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS && !bloomKeyPressed)
+    {
+        bloom = !bloom;
+        bloomKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_RELEASE)
+        bloomKeyPressed = false;
 
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !shadowsKeyPressed)
     {
@@ -755,7 +1389,10 @@ void processInput(GLFWwindow *window) {
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // The screen targets follow on the next frame, the pool allocates the new size when it is asked for it.
+    framebufferWidth = width;
+    framebufferHeight = height;
+    rg::glState().viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -783,7 +1420,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll((float)yoffset);
 }
 
-void DrawImGui(ProgramState *programState, PointLight *pointLight) {
+void DrawImGui(ProgramState *programState, PointLight *pointLight, RendererControls &controls) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -814,10 +1451,120 @@ void DrawImGui(ProgramState *programState, PointLight *pointLight) {
         ImGui::End();
     }
 
-    glViewport(0, 0, 256, 256);
+    {
+        ImGui::Begin("GL state");
+        const rg::GLState &state = rg::glState();
+        ImGui::Text("Issued calls: %lu", state.issued);
+        ImGui::Text("Elided calls: %lu", state.elided);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Frame ring");
+        ImGui::Text("Frames in flight: %d", rg::RingBuffer::FRAMES);
+        ImGui::Text("Stalls: %lu", controls.ring.stalls);
+        ImGui::Text("Overflows: %lu (%.1f MB per frame)", controls.ring.overflows, controls.ring.bytesPerFrame() / (1024.0 * 1024.0));
+        ImGui::Text("Persistently mapped: %s", controls.ring.persistentlyMapped() ? "yes" : "no");
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Post");
+        ImGui::Checkbox("Bloom", &bloom);
+        ImGui::DragFloat("Threshold", &controls.bloomChain.threshold, 0.01f, 0.0f, 10.0f);
+        ImGui::DragFloat("Knee", &controls.bloomChain.knee, 0.01f, 0.0f, 2.0f);
+        ImGui::SliderInt("Levels", &controls.bloomChain.levels, 1, rg::BloomChain::MAX_LEVELS);
+        ImGui::DragFloat("Filter radius", &controls.bloomChain.filterRadius, 0.05f, 0.0f, 4.0f);
+        ImGui::DragFloat("Strength", &controls.bloomChain.strength, 0.01f, 0.0f, 2.0f);
+        ImGui::DragFloat("Exposure", &exposure, 0.01f, 0.0f, 10.0f);
+        ImGui::Text("Mip chain: %.3f ms", controls.bloomTimer.milliseconds());
+        ImGui::DragFloat("Saturation", &saturation, 0.01f, 0.0f, 2.0f);
+        ImGui::DragFloat("Contrast", &contrast, 0.01f, 0.5f, 2.0f);
+        ImGui::ColorEdit3("Tint", (float *) &tint);
+        ImGui::Text("Render targets: %.1f MB in %d", controls.targetPool.bytes() / (1024.0 * 1024.0), (int) controls.targetPool.targetCount());
+        ImGui::Text("Allocations: %lu", controls.targetPool.allocations);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Resolution");
+        ImGui::Checkbox("Dynamic", &controls.dynamicResolution.enabled);
+        ImGui::DragFloat("GPU budget (ms)", &controls.dynamicResolution.budget, 0.1f, 4.0f, 50.0f);
+        ImGui::SliderFloat("Min scale", &controls.dynamicResolution.minScale, 0.25f, 1.0f);
+        ImGui::SliderFloat("Max scale", &controls.dynamicResolution.maxScale, controls.dynamicResolution.minScale, 1.0f);
+        ImGui::Text("GPU frame: %.2f ms", controls.frameTimer.milliseconds());
+        ImGui::Text("Scale: %.2f (%dx%d)", controls.dynamicResolution.scale(), controls.dynamicResolution.scaled(controls.targetPool.width()),
+                    controls.dynamicResolution.scaled(controls.targetPool.height()));
+        ImGui::Separator();
+        ImGui::Checkbox("TAA upscale", &controls.temporalAA.enabled);
+        ImGui::SliderFloat("Render scale", &controls.temporalAA.renderScale, 0.5f, 1.0f);
+        ImGui::SliderFloat("History blend", &controls.temporalAA.blend, 0.02f, 0.5f);
+        if (ImGui::Button("Reset history"))
+            controls.temporalAA.invalidate();
+        float taaScale = controls.temporalAA.enabled ? controls.temporalAA.renderScale : 1.0f;
+        ImGui::Text("Rendered: %dx%d", controls.dynamicResolution.scaled(controls.targetPool.width(), taaScale),
+                    controls.dynamicResolution.scaled(controls.targetPool.height(), taaScale));
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Frame graph");
+        ImGui::Text("Passes run: %d of %d", (int) controls.frameGraph.executed().size(), (int) controls.frameGraph.passCount());
+        for (const std::string &name : controls.frameGraph.executed())
+            ImGui::BulletText("%s", name.c_str());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Shadows");
+        const char *methods[] = {"Geometry shader", "Per face", "Vertex layer"};
+        ImGui::Combo("Caster path", &shadowMethod, methods, rg::SHADOW_METHOD_COUNT);
+        if (!rg::PointShadowMap::supported((rg::ShadowMethod)shadowMethod))
+            ImGui::Text("Vertex layer unsupported, drawing per face");
+        for (int method = 0; method < rg::SHADOW_METHOD_COUNT; method++)
+            ImGui::Text("%s: %.3f ms", methods[method], controls.shadowTimers[method].milliseconds());
+        if (ImGui::Button("Benchmark"))
+            shadowBenchmarkRequested = true;
+        ImGui::Text("Static refreshes: %lu", controls.shadowMap.staticRefreshes);
+        ImGui::DragFloat("Refresh distance", &controls.shadowMap.refreshDistance, 0.01, 0.0, 2.0);
+        ImGui::Separator();
+        const char *qualities[] = {"Reference (20 taps)", "Low (1 compare tap)", "Medium (probe, up to 8)", "High (probe, up to 20)",
+                                   "Variance (prefiltered)", "Paraboloid (2 views)"};
+        ImGui::Combo("Quality", &shadowQuality, qualities, rg::SHADOW_QUALITY_COUNT);
+        ImGui::Text("Shaded passes: %.3f ms", controls.lightingTimer.milliseconds());
+        ImGui::Checkbox("Half resolution mask", &shadowMask);
+        if (shadowMask)
+            ImGui::Text("Mask pass: %.3f ms", controls.shadowMaskTimer.milliseconds());
+        if (shadowQuality == rg::SHADOW_QUALITY_VARIANCE) {
+            ImGui::Text("Prefilter: %.3f ms", controls.momentTimer.milliseconds());
+            ImGui::SliderInt("Blur radius", &controls.momentMap.blurRadius, 0, 8);
+            ImGui::DragFloat("Min variance", &controls.momentMap.minVariance, 0.000001f, 0.0f, 0.001f, "%.6f");
+            ImGui::SliderFloat("Bleed reduction", &controls.momentMap.bleedReduction, 0.0f, 0.9f);
+        }
+        if (shadowQuality == rg::SHADOW_QUALITY_PARABOLOID)
+            ImGui::Text("Paraboloid pass: %.3f ms", controls.paraboloidTimer.milliseconds());
+        if (controls.shadowAtlas.enabled()) {
+            ImGui::Separator();
+            ImGui::DragInt("Atlas faces per frame", &controls.shadowAtlas.faceBudget, 1, 1, 6 * rg::ShadowAtlas::MAX_SLOTS);
+            ImGui::Text("Faces rendered: %d", controls.shadowAtlas.facesScheduled);
+            for (const rg::ShadowAtlas::Slot &slot : controls.shadowAtlas.allSlots()) {
+                if (slot.light < 0)
+                    ImGui::Text("%s cube %d: free", slot.tier == 0 ? "High" : "Low", slot.layer);
+                else
+                    ImGui::Text("%s cube %d: light %d, importance %.3f", slot.tier == 0 ? "High" : "Low",
+                                slot.layer, slot.light + 1, slot.importance);
+            }
+        } else {
+            ImGui::Text("No cube map arrays, only light 0 casts shadows");
+        }
+        ImGui::End();
+    }
+
+    rg::glState().viewport(0, 0, 256, 256);
     ImGui::Render();
+    // the backend restores the state it changes, the cache stays valid
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    rg::glState().viewport(0, 0, framebufferWidth, framebufferHeight);
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
@@ -861,32 +1608,3 @@ unsigned int loadCubemap(vector<std::string> faces)
 
     return textureID;
 }
-// for bloom
-//unsigned int quadVAO = 0;
-//unsigned int quadVBO;
-//void renderQuad()
-//{
-//    if (quadVAO == 0)
-//    {
-//        float quadVertices[] = {
-//                // positions        // texture Coords
-//                -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-//                -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-//                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-//                1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-//        };
-//        // setup plane VAO
-//        glGenVertexArrays(1, &quadVAO);
-//        glGenBuffers(1, &quadVBO);
-//        glBindVertexArray(quadVAO);
-//        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-//        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-//        glEnableVertexAttribArray(0);
-//        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-//        glEnableVertexAttribArray(1);
-//        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-//    }
-//    glBindVertexArray(quadVAO);
-//    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-//    glBindVertexArray(0);
-//}
\ No newline at end of file